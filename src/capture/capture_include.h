@@ -0,0 +1,9 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Capture sources hand switch edges to the main loop as (gpio state, time)
+ * pairs so debounce can run on the time an edge happened instead of the time
+ * the loop got around to polling it.
+ **/
+#include "sw_capture.c"
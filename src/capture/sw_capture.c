@@ -0,0 +1,224 @@
+/**
+ * PIO + DMA switch edge capture
+ * @author SpeedyPotato
+ *
+ * The switches PIO program pushes a [pin state, counter] pair every time a
+ * switch pin changes, and a DMA channel streams the pairs into
+ * sw_capture_ring. The counter counts down once every switches_TICK_CYCLES
+ * system clock cycles from when the state machine started, so every edge
+ * carries the time it happened no matter how busy core 0 was.
+ *
+ * The state machine samples the pins from the lowest to the highest switch
+ * pin. LED pins in between only change in response to switches, but
+ * WS2812B data or encoder pins would flood the ring, so capture is left off
+ * if any of them fall in that window.
+ *
+ * A DMA channel can only count down from 2^32 - 1 transfers, so a second
+ * channel, chained to the first, re-arms it with SW_CAPTURE_TRANSFERS
+ * whenever it finishes. Word counts are kept modulo SW_CAPTURE_TRANSFERS, a
+ * multiple of the ring size, so they run on seamlessly across re-arms.
+ *
+ * Records are converted to us one after the other, carrying the leftover
+ * cycles, so a record costs a 32 bit division (the hardware divider) unless
+ * it is so long after the last one that the cycles overflow 32 bits.
+ *
+ * sw_capture_decode only does arithmetic on the ring, so it can be exercised
+ * off the device with a made up ring.
+ **/
+#include "switches.pio.h"
+
+#define SW_CAPTURE_RING_BITS 8  // Ring size in bytes as a power of 2
+#define SW_CAPTURE_RING_WORDS ((1u << SW_CAPTURE_RING_BITS) / 4)
+#define SW_CAPTURE_TRANSFERS 0x80000000u  // Words per DMA run
+#define SW_CAPTURE_WRAP(words) ((words) & (SW_CAPTURE_TRANSFERS - 1))
+_Static_assert(SW_CAPTURE_TRANSFERS % SW_CAPTURE_RING_WORDS == 0,
+               "DMA runs must end on a ring boundary");
+
+typedef struct {
+  uint32_t read;      // Words consumed from the ring, SW_CAPTURE_WRAP'd
+  uint32_t count;     // PIO counter of the last record
+  uint64_t time;      // Time of the last record in us
+  uint32_t rem;       // Cycles of the last record past time, below mhz
+  uint32_t overruns;  // Records lost because the ring lapped the reader
+  uint32_t mhz;       // System clock in MHz
+  uint32_t fast_us;   // Record gap which still fits 32 bit cycle math
+} sw_capture_t;
+
+uint32_t sw_capture_ring[SW_CAPTURE_RING_WORDS]
+    __attribute__((aligned(1u << SW_CAPTURE_RING_BITS)));
+const uint32_t sw_capture_transfers = SW_CAPTURE_TRANSFERS;
+sw_capture_t sw_capture;
+bool sw_capture_active;
+int sw_capture_dma;
+int sw_capture_ctrl;
+uint sw_capture_pin_base;
+
+/**
+ * Sets up the decoder for a state machine which just started
+ * @param c Decoder state
+ * @param start_time Time the state machine started in us
+ * @param hz System clock
+ **/
+void sw_capture_reset(sw_capture_t* c, uint64_t start_time, uint32_t hz) {
+  memset(c, 0, sizeof(*c));
+  c->time = start_time;
+  c->mhz = hz / 1000000;
+  c->fast_us = UINT32_MAX / 2 / c->mhz;
+}
+
+/**
+ * Converts a PIO counter value to the time of its record
+ * @param c Decoder state
+ * @param count PIO counter of the record
+ * @param now Current time in us, at or after the record
+ * @return Time of the record in us
+ **/
+static inline uint64_t sw_capture_time(sw_capture_t* c, uint32_t count,
+                                       uint64_t now) {
+  uint32_t ticks = c->count - count;
+  c->count = count;
+  if (now - c->time < c->fast_us) {
+    // Under a counter period apart and the cycles fit 32 bits
+    uint32_t cycles = ticks * switches_TICK_CYCLES + c->rem;
+    c->time += cycles / c->mhz;
+    c->rem = cycles % c->mhz;
+    return c->time;
+  }
+
+  uint64_t cycles = (uint64_t)ticks * switches_TICK_CYCLES + c->rem;
+  uint64_t time = c->time + cycles / c->mhz;
+  // Add any whole counter periods which passed between the two records
+  uint64_t period = (uint64_t)switches_TICK_CYCLES << 32;
+  if (now > time) cycles += (now - time) * c->mhz / period * period;
+  c->time += cycles / c->mhz;
+  c->rem = cycles % c->mhz;
+  return c->time;
+}
+
+/**
+ * Pops the next record out of the ring
+ * @param c Decoder state
+ * @param ring Ring of SW_CAPTURE_RING_WORDS words
+ * @param written Words written into the ring so far, SW_CAPTURE_WRAP'd
+ * @param now Current time in us
+ * @param state Pin state after the edge, bit 0 = sw_capture_pin_base
+ * @param time Time of the edge in us
+ * @return false when there is no complete record
+ **/
+static inline bool sw_capture_decode(sw_capture_t* c, const uint32_t* ring,
+                                     uint32_t written, uint64_t now,
+                                     uint32_t* state, uint64_t* time) {
+  if (SW_CAPTURE_WRAP(written - c->read) > SW_CAPTURE_RING_WORDS) {
+    // Lapped, skip to the oldest record which is still whole
+    uint32_t read = SW_CAPTURE_WRAP((written - SW_CAPTURE_RING_WORDS + 1) & ~1u);
+    c->overruns += SW_CAPTURE_WRAP(read - c->read) / 2;
+    c->read = read;
+  }
+  if (SW_CAPTURE_WRAP(written - c->read) < 2) return false;
+
+  *state = ring[c->read % SW_CAPTURE_RING_WORDS];
+  *time =
+      sw_capture_time(c, ring[(c->read + 1) % SW_CAPTURE_RING_WORDS], now);
+  c->read = SW_CAPTURE_WRAP(c->read + 2);
+  return true;
+}
+
+/**
+ * Pops the next switch edge
+ * @param state Gpio state after the edge, pins outside the switch window
+ * read as 0
+ * @param time Time of the edge in us
+ * @return false when no edge is waiting
+ **/
+bool sw_capture_pop(uint32_t* state, uint64_t* time) {
+  uint32_t written = SW_CAPTURE_WRAP(
+      SW_CAPTURE_TRANSFERS - dma_hw->ch[sw_capture_dma].transfer_count);
+  if (!sw_capture_decode(&sw_capture, sw_capture_ring, written, time_us_64(),
+                         state, time)) {
+    return false;
+  }
+  *state <<= sw_capture_pin_base;
+  return true;
+}
+
+/**
+ * @param base Lowest pin sampled
+ * @param count Number of pins sampled
+ * @return true if no WS2812B or encoder pin is in the window
+ **/
+bool sw_capture_window_clear(uint base, uint count) {
+  uint end = base + count;
+  if (WS2812B_GPIO < end && WS2812B_GPIO + WS2812B_STRIPS > base) return false;
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    if (ENC_GPIO[i] < end && ENC_GPIO[i] + 2 > base) return false;
+  }
+  return true;
+}
+
+/**
+ * Starts edge capture on a free state machine and DMA channels
+ * @param pio PIO block to load the switches program into
+ * @return false if there was no room or the switch pins can't be sampled
+ * on their own, switches are polled instead
+ **/
+bool sw_capture_init(PIO pio) {
+  uint lo = SW_GPIO[0], hi = SW_GPIO[0];
+  for (int i = 1; i < SW_GPIO_SIZE; i++) {
+    if (SW_GPIO[i] < lo) lo = SW_GPIO[i];
+    if (SW_GPIO[i] > hi) hi = SW_GPIO[i];
+  }
+  if (!sw_capture_window_clear(lo, hi - lo + 1)) return false;
+
+  if (!pio_can_add_program(pio, &switches_program)) return false;
+  int sm = pio_claim_unused_sm(pio, false);
+  if (sm < 0) return false;
+  sw_capture_dma = dma_claim_unused_channel(false);
+  sw_capture_ctrl = dma_claim_unused_channel(false);
+  if (sw_capture_dma < 0 || sw_capture_ctrl < 0) {
+    if (sw_capture_dma >= 0) dma_channel_unclaim(sw_capture_dma);
+    if (sw_capture_ctrl >= 0) dma_channel_unclaim(sw_capture_ctrl);
+    pio_sm_unclaim(pio, sm);
+    return false;
+  }
+
+  // Sample exactly the switch window
+  uint16_t instructions[count_of(switches_program_instructions)];
+  memcpy(instructions, switches_program_instructions, sizeof(instructions));
+  instructions[switches_offset_sample] = pio_encode_in(pio_pins, hi - lo + 1);
+  pio_program_t program = switches_program;
+  program.instructions = instructions;
+  uint offset = pio_add_program(pio, &program);
+
+  dma_channel_config c = dma_channel_get_default_config(sw_capture_dma);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, SW_CAPTURE_RING_BITS);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+  channel_config_set_chain_to(&c, sw_capture_ctrl);
+  dma_channel_configure(sw_capture_dma, &c,
+                        sw_capture_ring,       // Destination pointer
+                        &pio->rxf[sm],         // Source pointer
+                        SW_CAPTURE_TRANSFERS,  // Number of transfers
+                        false                  // Start below
+  );
+
+  // Writes a full transfer count to the count trigger of the data channel,
+  // which carries on around the ring from where it stopped
+  dma_channel_config cc = dma_channel_get_default_config(sw_capture_ctrl);
+  channel_config_set_read_increment(&cc, false);
+  channel_config_set_write_increment(&cc, false);
+  dma_channel_configure(
+      sw_capture_ctrl, &cc,
+      &dma_channel_hw_addr(sw_capture_dma)->al1_transfer_count_trig,
+      &sw_capture_transfers,  // Source pointer
+      1,                      // Number of transfers
+      false                   // Started by the data channel
+  );
+  dma_channel_start(sw_capture_dma);
+
+  sw_capture_pin_base = lo;
+  switches_program_init(pio, sm, offset, lo);
+  sw_capture_reset(&sw_capture, time_us_64(), clock_get_hz(clk_sys));
+  sw_capture_active = true;
+  return true;
+}
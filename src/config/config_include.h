@@ -0,0 +1,8 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Settings which can change while running. controller_config.h holds their
+ * defaults, code should read them from config.
+ **/
+#include "runtime_config.c"
@@ -0,0 +1,90 @@
+/**
+ * Runtime settings
+ * @author SpeedyPotato
+ *
+ * config starts out from controller_config.h, is replaced by the copy saved
+ * in flash if there is one, and can be read and changed by the host with
+ * feature report REPORT_ID_CONFIG. Every field is read where it is used, so a
+ * change takes effect on the next loop iteration. Report layout, multi byte
+ * fields little endian:
+ *   0      flags, CONFIG_SAVE on SET also saves to flash, 0 on GET
+ *   1-4    debounce_us
+ *   5-8    reactive_timeout_us
+ *   9      mouse_sens
+ *   10     enc_rev, bit i reverses encoder i
+ *   11     debounce_mode, index into debounce_modes
+ *   12     ws2812b_mode, index into ws2812b_modes
+ *   13-    keycode, one per switch, below KEYCODE_END
+ **/
+
+#define CONFIG_SAVE 0x01
+#define CONFIG_SIZE (offsetof(config_t, keycode) + SW_GPIO_SIZE)
+#define KEYCODE_END 248  // Keycodes from here have no bit in the NKRO report
+
+typedef struct {
+  uint32_t debounce_us;          // Switch debounce delay
+  uint32_t reactive_timeout_us;  // HID to reactive lights timeout
+  uint8_t mouse_sens;            // Mouse sensitivity multiplier
+  uint8_t enc_rev;               // Reversed encoders, bit per encoder
+  uint8_t debounce_mode;         // Index into debounce_modes
+  uint8_t ws2812b_mode;          // Index into ws2812b_modes
+  uint8_t keycode[SW_GPIO_SIZE];  // Key per switch in keyboard mode
+} config_t;
+
+_Static_assert(CONFIG_REPORT_SIZE == 1 + CONFIG_SIZE,
+               "config_t has padding before keycode");
+_Static_assert(CONFIG_REPORT_SIZE < CFG_TUD_HID_EP_BUFSIZE,
+               "Too many switches for the config report");
+_Static_assert(ENC_GPIO_SIZE <= 8, "enc_rev has a bit per encoder");
+
+config_t config;
+
+/**
+ * Fills in the controller_config.h defaults
+ **/
+void config_default(config_t* c) {
+  c->debounce_us = SW_DEBOUNCE_TIME_US;
+  c->reactive_timeout_us = REACTIVE_TIMEOUT_MAX;
+  c->mouse_sens = MOUSE_SENS;
+  c->enc_rev = 0;
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    c->enc_rev |= ENC_REV[i] << i;
+  }
+  c->debounce_mode = SW_DEBOUNCE_MODE;
+  c->ws2812b_mode = 0;
+  memcpy(c->keycode, SW_KEYCODE, SW_GPIO_SIZE);
+}
+
+/**
+ * Checks settings from the host or flash before they are used
+ * @param c Settings
+ * @param debounce_count Number of debounce modes
+ * @param ws2812b_count Number of WS2812B modes
+ **/
+bool config_valid(const config_t* c, int debounce_count, int ws2812b_count) {
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if (c->keycode[i] >= KEYCODE_END) return false;
+  }
+  return c->debounce_us > 0 && c->debounce_us <= 1000000 &&
+         c->mouse_sens > 0 && c->debounce_mode < debounce_count &&
+         c->ws2812b_mode < ws2812b_count;
+}
+
+/**
+ * @param i Encoder
+ * @return true if encoder i is reversed
+ **/
+static inline bool enc_rev(int i) { return (config.enc_rev >> i) & 1; }
+
+/**
+ * GET_REPORT for REPORT_ID_CONFIG
+ * @param buffer Report data without the report ID
+ * @param reqlen Space in buffer
+ * @return Length of the report, 0 to stall
+ **/
+uint16_t config_get_report(uint8_t* buffer, uint16_t reqlen) {
+  if (reqlen < CONFIG_REPORT_SIZE) return 0;
+  buffer[0] = 0;
+  memcpy(&buffer[1], &config, CONFIG_SIZE);
+  return CONFIG_REPORT_SIZE;
+}
@@ -3,33 +3,70 @@
 
 #define SW_GPIO_SIZE 11               // Number of switches
 #define LED_GPIO_SIZE 10              // Number of switch LEDs
-#define ENC_GPIO_SIZE 2               // Number of encoders
+#define ENC_GPIO_SIZE 2               // Number of encoders, up to 7
 #define ENC_PPR 600                   // Encoder PPR
 #define MOUSE_SENS 1                  // Mouse sensitivity multiplier
+#define MOUSE_ACCEL 0                 // 0 linear 1 precision 2 accelerated
 #define ENC_DEBOUNCE false            // Encoder Debouncing
+#define ENC_DMA_CHAIN true            // Re-arm encoder DMA without IRQs
 #define SW_DEBOUNCE_TIME_US 8000      // Switch debounce delay in us
+#define SW_DEBOUNCE_MODE 0            // 0 eager 1 deferred 2 vertical 3 adaptive
+#define SW_ADAPT_MIN_US 1000          // Shortest adaptive debounce window
+#define SW_EDGE_CAPTURE false         // Timestamp switch edges with PIO + DMA
+#define DEBOUNCE_METRICS false        // Per switch debounce quality metrics
 #define ENC_PULSE (ENC_PPR * 4)       // 4 pulses per PPR
+#define ENC_PREDICT_US 0              // Extrapolate gamepad axes by us, 0 off
+#define JOY_AXIS_BITS 16              // Gamepad axis resolution, 8 or 16
+#define JOY_AXIS_MAX ((1u << JOY_AXIS_BITS) - 1)
 #define REACTIVE_TIMEOUT_MAX 1000000  // HID to reactive timeout in us
+#define HID_IDLE_TIMEOUT_US 500000    // Resend unchanged reports after us
+#define LATENCY_STATS true            // Measure switch to report latency
+#define USB_SCHED_PERIOD_US 0         // Run USB + inputs from a timer, 0 loop
+#define USB_SOF_SYNC false            // Build reports just before each frame
+#define USB_SOF_LEAD_US 100           // How long before the frame, in us
 #define WS2812B_LED_SIZE 10           // Number of WS2812B LEDs
 #define WS2812B_LED_ZONES 2           // Number of WS2812B LED Zones
+#define WS2812B_GAMMA false           // Gamma correct WS2812B colors
+#define WS2812B_FRAME_US 5000         // WS2812B frame period, 200 Hz
 #define WS2812B_LEDS_PER_ZONE \
   WS2812B_LED_SIZE / WS2812B_LED_ZONES  // Number of LEDs per zone
+#define WS2812B_GPIO 28   // First WS2812B data pin
+#define WS2812B_STRIPS 1  // Strips on consecutive pins from WS2812B_GPIO
+#define WS2812B_LEDS_PER_STRIP \
+  (WS2812B_LED_SIZE / WS2812B_STRIPS)  // Number of LEDs per strip
 
 #ifdef PICO_GAME_CONTROLLER_C
 
 // MODIFY KEYBINDS HERE, MAKE SURE LENGTHS MATCH SW_GPIO_SIZE
-const uint8_t SW_KEYCODE[] = {HID_KEY_D, HID_KEY_F, HID_KEY_J, HID_KEY_K,
-                              HID_KEY_C, HID_KEY_M, HID_KEY_A, HID_KEY_B,
-                              HID_KEY_1, HID_KEY_E, HID_KEY_G};
-const uint8_t SW_GPIO[] = {
-    4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 27,
-};
-const uint8_t LED_GPIO[] = {
-    5, 7, 9, 11, 13, 15, 17, 19, 21, 26,
-};
+#define SW_KEYCODES(X)                                                   \
+  X(HID_KEY_D) X(HID_KEY_F) X(HID_KEY_J) X(HID_KEY_K) X(HID_KEY_C)       \
+  X(HID_KEY_M) X(HID_KEY_A) X(HID_KEY_B) X(HID_KEY_1) X(HID_KEY_E)       \
+  X(HID_KEY_G)
+#define SW_KEYCODE_ENTRY(k) k,
+const uint8_t SW_KEYCODE[] = {SW_KEYCODES(SW_KEYCODE_ENTRY)};
+
+// MODIFY PINS HERE, SW_GPIO_SIZE switches and LED_GPIO_SIZE LEDs
+#define SW_GPIOS(X) \
+  X(4) X(6) X(8) X(10) X(12) X(14) X(16) X(18) X(20) X(22) X(27)
+#define LED_GPIOS(X) X(5) X(7) X(9) X(11) X(13) X(15) X(17) X(19) X(21) X(26)
+#define GPIO_ENTRY(p) p,
+#define GPIO_MASK_ENTRY(p) | (1u << (p))
+#define GPIO_VALID_ENTRY(p) && (p) < 30
+const uint8_t SW_GPIO[] = {SW_GPIOS(GPIO_ENTRY)};
+const uint8_t LED_GPIO[] = {LED_GPIOS(GPIO_ENTRY)};
+#define SW_GPIO_MASK (0u SW_GPIOS(GPIO_MASK_ENTRY))
+#define LED_GPIO_MASK (0u LED_GPIOS(GPIO_MASK_ENTRY))
+_Static_assert(sizeof(SW_GPIO) == SW_GPIO_SIZE, "SW_GPIO_SIZE pins needed");
+_Static_assert(sizeof(LED_GPIO) == LED_GPIO_SIZE, "LED_GPIO_SIZE pins needed");
+_Static_assert(1 SW_GPIOS(GPIO_VALID_ENTRY) LED_GPIOS(GPIO_VALID_ENTRY),
+               "Pins go up to GPIO 29");
+_Static_assert(__builtin_popcount(SW_GPIO_MASK) == SW_GPIO_SIZE &&
+                   __builtin_popcount(LED_GPIO_MASK) == LED_GPIO_SIZE,
+               "Pin listed twice");
+_Static_assert((SW_GPIO_MASK & LED_GPIO_MASK) == 0,
+               "Pin used for both a switch and an LED");
 const uint8_t ENC_GPIO[] = {0, 2};      // L_ENC(0, 1); R_ENC(2, 3)
 const bool ENC_REV[] = {false, false};  // Reverse Encoders
-const uint8_t WS2812B_GPIO = 28;
 
 #endif
 
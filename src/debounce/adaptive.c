@@ -0,0 +1,91 @@
+/**
+ * Version of debounce_eager which learns how long each switch bounces. A
+ * change is sent immediately and held for that switch's window. Raw changes
+ * inside the window are bounces; when the window runs out, the time from the
+ * edge to the last bounce is folded into a slowly decaying peak and the next
+ * window becomes twice that peak, kept between SW_ADAPT_MIN_US and
+ * config.debounce_us. Windows start at config.debounce_us and shrink while a
+ * switch stays clean.
+ *
+ * An edge accepted less than two windows after the previous one is counted as
+ * an escaped bounce, and the peak jumps to the time between the two edges so
+ * the window grows right away.
+ *
+ * Per switch statistics are readable over feature report REPORT_ID_DEBOUNCE,
+ * see metrics.c.
+ * @author SpeedyPotato
+ **/
+
+typedef struct {
+  uint32_t window_us;      // Current hold time
+  uint32_t peak_us;        // Decaying peak bounce duration
+  uint32_t bounce_max_us;  // Longest bounce seen
+  uint32_t edges;          // Accepted changes
+  uint32_t bounces;        // Raw changes rejected inside the window
+  uint32_t escapes;        // Edges which came too soon, likely bounces
+} adapt_t;
+
+adapt_t adapt[SW_GPIO_SIZE];
+uint64_t adapt_bounce_timestamp[SW_GPIO_SIZE];  // Last bounce in the window
+uint32_t adapt_held;  // Switches inside their window
+
+/**
+ * Sets the window from the peak
+ * @param a Switch state
+ **/
+static inline void adapt_window(adapt_t* a) {
+  uint32_t window = a->peak_us * 2;
+  if (window < SW_ADAPT_MIN_US) window = SW_ADAPT_MIN_US;
+  if (window > config.debounce_us) window = config.debounce_us;
+  a->window_us = window;
+}
+
+void debounce_adaptive() {
+  if (adapt[0].window_us == 0) {
+    for (int i = 0; i < SW_GPIO_SIZE; i++) {
+      adapt[i].peak_us = config.debounce_us / 2;
+      adapt_window(&adapt[i]);
+    }
+  }
+
+  // Raw changes of held switches are bounces
+  uint32_t bounced = (sw_raw_val ^ sw_prev_raw_val) & adapt_held;
+  for (int i = 0; bounced != 0; i++, bounced >>= 1) {
+    if (bounced & 1) {
+      adapt[i].bounces++;
+      adapt_bounce_timestamp[i] = sw_sample_time;
+    }
+  }
+
+  // Windows which ran out learn from how long their switch bounced
+  uint32_t held = adapt_held;
+  for (int i = 0; held != 0; i++, held >>= 1) {
+    adapt_t* a = &adapt[i];
+    if ((held & 1) && sw_sample_time - sw_timestamp[i] >= a->window_us) {
+      uint32_t bounce = adapt_bounce_timestamp[i] - sw_timestamp[i];
+      if (bounce > a->bounce_max_us) a->bounce_max_us = bounce;
+      a->peak_us -= a->peak_us >> 6;
+      if (bounce > a->peak_us) a->peak_us = bounce;
+      adapt_window(a);
+      adapt_held &= ~(1u << i);
+    }
+  }
+
+  // Accept changes on switches which are not held, then hold them
+  uint32_t changed = (sw_cooked_val ^ sw_raw_val) & ~adapt_held;
+  for (int i = 0; changed != 0; i++, changed >>= 1) {
+    if (changed & 1) {
+      adapt_t* a = &adapt[i];
+      uint32_t since = sw_sample_time - sw_timestamp[i];
+      if (a->edges != 0 && since < a->window_us * 2) {
+        a->escapes++;
+        if (since > a->peak_us) a->peak_us = since;
+        adapt_window(a);
+      }
+      sw_cooked_val ^= 1u << i;
+      sw_timestamp[i] = adapt_bounce_timestamp[i] = sw_sample_time;
+      adapt_held |= 1u << i;
+      a->edges++;
+    }
+  }
+}
@@ -6,14 +6,31 @@
  * These are saved in report.buttons as truth. Create debounce mode as desired
  * and then add the #include here.
  *
- * At the start of the debounce function, sw_cooked_val is the state of the
- * buttons from the previous cycle. You should change it to be the new state
- * by the end of the function. sw_prev_raw_val contains the state of the GPIO
- * pins on the previous cycle. sw_timestamp is for you to use.
+ * All switch states are bitmasks in button order (bit i is SW_GPIO[i]),
+ * 1 = pressed. sw_raw_val is the snapshot of the switches taken this cycle at
+ * sw_sample_time; use these rather than reading the GPIO or the timer again so
+ * every stage sees the same state. At the start of the debounce function,
+ * sw_cooked_val is the state of the buttons from the previous cycle. You
+ * should change it to be the new state by the end of the function.
+ * sw_prev_raw_val contains the state of the GPIO pins on the previous cycle.
+ * sw_timestamp is for you to use.
  **/
-extern bool sw_prev_raw_val[SW_GPIO_SIZE];
-extern bool sw_cooked_val[SW_GPIO_SIZE];
+extern uint32_t sw_raw_val;
+extern uint32_t sw_prev_raw_val;
+extern uint32_t sw_cooked_val;
 extern uint64_t sw_timestamp[SW_GPIO_SIZE];
+extern uint64_t sw_sample_time;
 
+#include "adaptive.c"
 #include "deferred.c"
 #include "eager.c"
+#include "vertical.c"
+#include "metrics.c"
+
+// Selectable by config.debounce_mode, only append so saved indices stay valid
+void (*const debounce_modes[])() = {
+    &debounce_eager,
+    &debounce_deferred,
+    &debounce_vertical,
+    &debounce_adaptive,
+};
@@ -5,14 +5,15 @@
  **/
 
 void debounce_deferred() {
-  for (int i = SW_GPIO_SIZE - 1; i >= 0; i--) {
-    bool sw_raw_val = !gpio_get(SW_GPIO[i]);
+  uint32_t bounced = sw_raw_val ^ sw_prev_raw_val;
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    uint32_t bit = 1u << i;
 
-    if (sw_raw_val != sw_prev_raw_val[i]) {
-      sw_timestamp[i] = time_us_64();
-    } else if (sw_timestamp[i] != 0 && 
-        time_us_64() - sw_timestamp[i] >= SW_DEBOUNCE_TIME_US) {
-      sw_cooked_val[i] = sw_raw_val;
+    if (bounced & bit) {
+      sw_timestamp[i] = sw_sample_time;
+    } else if (sw_timestamp[i] != 0 &&
+               sw_sample_time - sw_timestamp[i] >= config.debounce_us) {
+      sw_cooked_val = (sw_cooked_val & ~bit) | (sw_raw_val & bit);
       sw_timestamp[i] = 0;
     }
   }
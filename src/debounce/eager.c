@@ -5,13 +5,12 @@
  **/
 
 void debounce_eager() {
-  for (int i = 0; i < SW_GPIO_SIZE; i++) {
-    bool sw_raw_val = !gpio_get(SW_GPIO[i]);
-
-    if (time_us_64() - sw_timestamp[i] >= SW_DEBOUNCE_TIME_US &&
-        sw_cooked_val[i] != sw_raw_val) {
-      sw_cooked_val[i] = sw_raw_val;
-      sw_timestamp[i] = time_us_64();
+  uint32_t changed = sw_cooked_val ^ sw_raw_val;
+  for (int i = 0; changed != 0; i++, changed >>= 1) {
+    if ((changed & 1) &&
+        sw_sample_time - sw_timestamp[i] >= config.debounce_us) {
+      sw_cooked_val ^= 1u << i;
+      sw_timestamp[i] = sw_sample_time;
     }
   }
 }
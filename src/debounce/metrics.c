@@ -0,0 +1,141 @@
+/**
+ * Debounce quality metrics
+ * @author SpeedyPotato
+ *
+ * Watches raw and cooked switch states after every debounce_mode call, so
+ * debounce modes can be compared on real switches:
+ * - Added press / release latency: from the first raw edge away from the
+ *   cooked state to the cooked change. A raw change which returns to the
+ *   cooked state and stays there for config.debounce_us was rejected and
+ *   doesn't count.
+ * - Rejected chatter: raw edges which never became cooked edges, that is
+ *   raw_edges - presses - releases.
+ * - Missed presses: raw presses held for at least DEBOUNCE_MISS_US which
+ *   ended without the cooked state ever going pressed.
+ * Metrics reset whenever the debounce mode changes. They only run when
+ * DEBOUNCE_METRICS is set in controller_config.h, since they cost time after
+ * every debounce_mode call; test/debounce_replay.c compares modes off the
+ * device instead.
+ *
+ * Feature report REPORT_ID_DEBOUNCE: SET byte 0 = switch selects which switch
+ * GET returns. GET: byte 0 = switch, byte 1 = config.debounce_mode, then
+ * debounce_metrics_t and adapt_t of that switch as little endian uint32s.
+ **/
+
+#define DEBOUNCE_MISS_US 5000
+
+typedef struct {
+  uint32_t press_latency_us;    // Sum of added press latency
+  uint32_t press_latency_max_us;
+  uint32_t presses;             // Cooked presses
+  uint32_t release_latency_us;  // Sum of added release latency
+  uint32_t release_latency_max_us;
+  uint32_t releases;            // Cooked releases
+  uint32_t raw_edges;           // Raw edges, including bounces
+  uint32_t missed;              // Presses which never came through
+} debounce_metrics_t;
+
+_Static_assert(2 + sizeof(debounce_metrics_t) + sizeof(adapt_t) ==
+                   DEBOUNCE_REPORT_SIZE,
+               "Debounce report doesn't match its descriptor");
+
+debounce_metrics_t debounce_metrics[SW_GPIO_SIZE];
+uint64_t dm_edge_timestamp[SW_GPIO_SIZE];  // First raw edge not yet cooked
+uint64_t dm_raw_timestamp[SW_GPIO_SIZE];   // Last raw edge
+uint32_t dm_pending;  // Switches with a raw edge not yet cooked
+uint32_t dm_seen;     // Switches which were cooked pressed in this raw press
+uint32_t dm_raw;      // sw_raw_val at the last call
+uint32_t dm_cooked;   // sw_cooked_val at the last call
+uint8_t dm_selected;
+
+/**
+ * Clears every metric
+ **/
+void debounce_metrics_reset() {
+  memset(debounce_metrics, 0, sizeof(debounce_metrics));
+  dm_pending = 0;
+}
+
+/**
+ * Compares the state before and after a debounce_mode call, call after every
+ * one of them
+ **/
+void debounce_metrics_update() {
+  if (!DEBOUNCE_METRICS) return;
+  uint32_t raw_changed = sw_raw_val ^ dm_raw;
+  uint32_t cooked_changed = sw_cooked_val ^ dm_cooked;
+  uint32_t rising = raw_changed & sw_raw_val;
+  uint32_t check = raw_changed | cooked_changed | dm_pending;
+
+  dm_seen = (dm_seen & ~rising) | sw_cooked_val;
+  for (int i = 0; check != 0; i++, check >>= 1) {
+    if (!(check & 1)) continue;
+    debounce_metrics_t* m = &debounce_metrics[i];
+    uint32_t bit = 1u << i;
+
+    if (raw_changed & bit) {
+      if (!(sw_raw_val & bit) && !(dm_seen & bit) &&
+          sw_sample_time - dm_raw_timestamp[i] >= DEBOUNCE_MISS_US) {
+        m->missed++;
+      }
+      dm_raw_timestamp[i] = sw_sample_time;
+      m->raw_edges++;
+    }
+
+    if (cooked_changed & bit) {
+      uint32_t latency = (dm_pending & bit)
+                             ? sw_sample_time - dm_edge_timestamp[i]
+                             : 0;
+      if (sw_cooked_val & bit) {
+        m->presses++;
+        m->press_latency_us += latency;
+        if (latency > m->press_latency_max_us) {
+          m->press_latency_max_us = latency;
+        }
+      } else {
+        m->releases++;
+        m->release_latency_us += latency;
+        if (latency > m->release_latency_max_us) {
+          m->release_latency_max_us = latency;
+        }
+      }
+      dm_pending &= ~bit;
+    } else if ((sw_raw_val ^ sw_cooked_val) & bit) {
+      if (!(dm_pending & bit)) {
+        dm_pending |= bit;
+        dm_edge_timestamp[i] = sw_sample_time;
+      }
+    } else if ((dm_pending & bit) &&
+               sw_sample_time - dm_raw_timestamp[i] >= config.debounce_us) {
+      dm_pending &= ~bit;  // Settled back, the edge was rejected
+    }
+  }
+  dm_raw = sw_raw_val;
+  dm_cooked = sw_cooked_val;
+}
+
+/**
+ * SET_REPORT for REPORT_ID_DEBOUNCE, selects a switch
+ * @param buffer Report data without the report ID
+ * @param len Length of buffer
+ **/
+void debounce_set_report(uint8_t const* buffer, uint16_t len) {
+  if (len >= 1 && buffer[0] < SW_GPIO_SIZE) dm_selected = buffer[0];
+}
+
+/**
+ * GET_REPORT for REPORT_ID_DEBOUNCE
+ * @param buffer Report data without the report ID
+ * @param reqlen Space in buffer
+ * @return Length of the report, 0 to stall
+ **/
+uint16_t debounce_get_report(uint8_t* buffer, uint16_t reqlen) {
+  if (reqlen < DEBOUNCE_REPORT_SIZE) return 0;
+  buffer[0] = dm_selected;
+  buffer[1] = config.debounce_mode;
+  memcpy(&buffer[2], &debounce_metrics[dm_selected],
+         sizeof(debounce_metrics_t));
+  memcpy(&buffer[2 + sizeof(debounce_metrics_t)], &adapt[dm_selected],
+         sizeof(adapt_t));
+  return DEBOUNCE_REPORT_SIZE;
+}
@@ -0,0 +1,49 @@
+/**
+ * Bit-parallel version of debounce_eager. Sends a report immediately when a
+ * switch changes and holds it for n amount of time, but keeps the hold time
+ * of every switch in a 4 bit vertical counter (bit k of every counter lives in
+ * vc_bit[k]), so one call is a handful of word operations for up to 32
+ * switches.
+ *
+ * Counters count down once per VC_TICK_US. A changed switch loads
+ * VC_TICKS + 1, so the hold time lands between VC_TICKS and VC_TICKS + 1
+ * ticks: config.debounce_us rounded up to whole ticks, plus up to a tick. It
+ * is never shorter than debounce_eager.
+ * @author SpeedyPotato
+ **/
+
+#define VC_TICKS 14  // Hold time in counter ticks, at most 14 for 4 bits
+#define VC_TICK_US ((config.debounce_us + VC_TICKS - 1) / VC_TICKS)
+
+uint32_t vc_bit[4];
+uint64_t vc_tick_timestamp;
+
+void debounce_vertical() {
+  uint32_t running = vc_bit[0] | vc_bit[1] | vc_bit[2] | vc_bit[3];
+
+  // Count down every running counter once per elapsed tick
+  while (sw_sample_time - vc_tick_timestamp >= VC_TICK_US) {
+    if (running == 0) {
+      vc_tick_timestamp = sw_sample_time;
+      break;
+    }
+    uint32_t borrow = running;
+    for (int k = 0; k < 4; k++) {
+      vc_bit[k] ^= borrow;
+      borrow &= vc_bit[k];
+    }
+    running = vc_bit[0] | vc_bit[1] | vc_bit[2] | vc_bit[3];
+    vc_tick_timestamp += VC_TICK_US;
+  }
+
+  // Accept changes on switches which are not held, then hold them
+  uint32_t accept = (sw_cooked_val ^ sw_raw_val) & ~running;
+  sw_cooked_val ^= accept;
+  for (int k = 0; k < 4; k++) {
+    if ((VC_TICKS + 1) & (1 << k)) {
+      vc_bit[k] |= accept;
+    } else {
+      vc_bit[k] &= ~accept;
+    }
+  }
+}
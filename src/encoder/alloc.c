@@ -0,0 +1,57 @@
+/**
+ * Encoder state machine allocation
+ * @author SpeedyPotato
+ *
+ * Every encoder needs a state machine running the encoders program and a DMA
+ * channel copying its count into enc_val. Encoders fill the free state
+ * machines of PIO 0 first and spill over to PIO 1, so up to 4 encoders leave
+ * PIO 1 to lighting and edge capture. enc_alloc only works on bitmasks so it
+ * can be exercised off the device.
+ *
+ * With ENC_DMA_CHAIN, each encoder's DMA channel chains to a control channel
+ * which writes the FIFO address back into the data channel's read address
+ * trigger, so capture keeps going with no CPU involvement. Encoders which
+ * can't get a control channel fall back to dma_handler restarting them every
+ * ENC_DMA_IRQ_TRANSFERS counts.
+ **/
+
+// 2 PIOs x 4 state machines, one is kept for WS2812B
+_Static_assert(ENC_GPIO_SIZE <= 7, "Not enough state machines for encoders");
+
+#define ENC_DMA_IRQ_TRANSFERS 0x10
+#define ENC_DMA_CHAIN_TRANSFERS 0xffffffffu
+
+typedef struct {
+  uint8_t pio;  // PIO index
+  uint8_t sm;   // State machine
+  uint8_t dma;  // DMA channel
+  int8_t ctrl;  // Control channel re-arming dma, -1 if dma_handler does
+} enc_slot_t;
+
+enc_slot_t enc_slot[ENC_GPIO_SIZE];
+io_ro_32* enc_rxf[ENC_GPIO_SIZE];  // RX FIFO each DMA channel reads
+volatile uint32_t enc_dma_irqs;    // dma_handler restarts since boot
+
+/**
+ * Picks a state machine for every encoder, lowest PIO and SM first
+ * @param n Number of encoders
+ * @param free_sm Unclaimed state machines of each PIO, bit per SM
+ * @param fits Whether each PIO has room for the encoders program
+ * @param slots Filled in with pio and sm of each encoder
+ * @return false if there aren't enough state machines
+ **/
+bool enc_alloc(int n, const uint8_t free_sm[NUM_PIOS],
+               const bool fits[NUM_PIOS], enc_slot_t* slots) {
+  int e = 0;
+  for (int p = 0; p < NUM_PIOS && e < n; p++) {
+    if (!fits[p]) continue;
+    for (int sm = 0; sm < 4 && e < n; sm++) {
+      if (free_sm[p] & (1u << sm)) {
+        slots[e].pio = p;
+        slots[e].sm = sm;
+        e++;
+      }
+    }
+  }
+  return e == n;
+}
@@ -0,0 +1,11 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Encoder helpers which work on enc_val, the raw counts kept up to date by
+ * the encoder state machines and DMA.
+ **/
+extern uint32_t enc_val[ENC_GPIO_SIZE];
+
+#include "alloc.c"
+#include "velocity.c"
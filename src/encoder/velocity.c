@@ -0,0 +1,56 @@
+/**
+ * Encoder velocity estimation
+ * @author SpeedyPotato
+ *
+ * Velocity is estimated from count deltas over the time between changes and
+ * smoothed with a 1/4 exponential filter. While an encoder sits still, its
+ * speed can be at most 1 count per time since the last change, which bounds
+ * the estimate so it falls off quickly when a knob stops. Velocities are in
+ * raw enc_val counts per second, before ENC_REV is applied.
+ **/
+
+#define ENC_VEL_TIMEOUT_US 50000  // No change for this long is standing still
+#define ENC_VEL_SMOOTH_SHIFT 2
+
+typedef struct {
+  uint32_t count;      // enc_val at the last change
+  uint64_t timestamp;  // Time of the last change
+  int32_t velocity;    // Counts per second
+} enc_vel_t;
+
+enc_vel_t enc_vel[ENC_GPIO_SIZE];
+
+/**
+ * Update velocity estimates, call once per loop
+ * @param now Current time in us
+ **/
+void enc_velocity_update(uint64_t now) {
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    enc_vel_t* v = &enc_vel[i];
+    int32_t delta = (int32_t)(enc_val[i] - v->count);
+    uint64_t dt = now - v->timestamp;
+    if (dt > ENC_VEL_TIMEOUT_US) dt = ENC_VEL_TIMEOUT_US;
+
+    if (delta != 0) {
+      int32_t inst = (int64_t)delta * 1000000 / (int64_t)(dt ? dt : 1);
+      v->velocity += (inst - v->velocity) >> ENC_VEL_SMOOTH_SHIFT;
+      v->count += delta;
+      v->timestamp = now;
+    } else if (dt >= ENC_VEL_TIMEOUT_US) {
+      v->velocity = 0;
+    } else if (dt > 0) {
+      int32_t bound = 1000000 / (int32_t)dt;
+      if (v->velocity > bound) v->velocity = bound;
+      if (v->velocity < -bound) v->velocity = -bound;
+    }
+  }
+}
+
+/**
+ * Counts an encoder is expected to move in the next lead_us
+ * @param i Encoder index
+ * @param lead_us Time to extrapolate over in us
+ **/
+static inline int32_t enc_predict(int i, uint32_t lead_us) {
+  return (int64_t)enc_vel[i].velocity * lead_us / 1000000;
+}
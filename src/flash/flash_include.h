@@ -0,0 +1,7 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Settings which survive a power cycle, kept in the last flash sectors.
+ **/
+#include "kv_store.c"
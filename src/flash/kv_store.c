@@ -0,0 +1,283 @@
+/**
+ * Log structured key/value store in the last 2 flash sectors
+ * @author SpeedyPotato
+ *
+ * Each sector starts with a header {magic, seq, ~seq} followed by records
+ * {key, len, crc16} + value, padded to 4 bytes. A write appends a record to
+ * the active sector, so the newest record of a key wins and a sector is only
+ * erased once every 4 KB worth of writes, alternating between the 2 sectors.
+ * Reads go straight through XIP, kv_get hands back a pointer into flash.
+ *
+ * Power loss safety:
+ * - A torn or unverifiable record ends the log. Everything before it still
+ *   reads back, and the next write compacts into the other sector.
+ * - Compaction erases the other sector, copies the newest record of every key
+ *   into it and only then programs its header. Until that header is complete
+ *   the old sector stays the newest valid one.
+ * - An interrupted erase can only flip bits to 1, which breaks seq == ~seq_inv,
+ *   so a half erased sector never looks valid.
+ *
+ * Flash can't be read while it is programmed, so writes run with interrupts
+ * off and core 1 parked if it set up multicore lockout. Writes take 1 ms for
+ * an append and up to 100 ms for a compaction, and only happen when a value
+ * changed.
+ **/
+#include "hardware/flash.h"
+
+#define KV_OFFSET (PICO_FLASH_SIZE_BYTES - 2 * FLASH_SECTOR_SIZE)
+#define KV_MAGIC 0x4b565331u
+#define KV_KEY_ERASED 0xff
+#define KV_ALIGN(len) (((len) + 3u) & ~3u)
+
+enum {
+  KV_BOOT_KEY_MODE = 1,   // uint8_t, keyboard mode instead of gamepad
+  KV_BOOT_TURBOCHARGER,   // Retired, the RGB mode is part of KV_CONFIG
+  KV_BOOT_RGB_OFF,        // uint8_t, WS2812B off
+  KV_CONFIG,              // config_t up to the end of keycode
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t seq_inv;  // ~seq
+} kv_header_t;
+
+typedef struct {
+  uint8_t key;
+  uint8_t len;
+  uint16_t crc;  // crc16 over key, len and value
+} kv_record_t;
+
+int kv_active;     // Active sector, -1 if neither sector is valid
+uint32_t kv_seq;   // seq of the active sector
+uint32_t kv_tail;  // First free byte of the active sector, 0 if torn
+uint8_t kv_buf[FLASH_SECTOR_SIZE];  // Compaction image
+
+/**
+ * @param sector 0 or 1
+ * @return Sector contents through XIP
+ **/
+static inline const uint8_t* kv_sector(int sector) {
+  return (const uint8_t*)(XIP_BASE + KV_OFFSET + sector * FLASH_SECTOR_SIZE);
+}
+
+/**
+ * CRC-16/CCITT of a record
+ **/
+uint16_t kv_crc(uint8_t key, uint8_t len, const uint8_t* value) {
+  uint16_t crc = 0xffff;
+  uint8_t head[2] = {key, len};
+  for (int i = 0; i < 2 + len; i++) {
+    crc ^= (uint16_t)(i < 2 ? head[i] : value[i - 2]) << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/**
+ * @return true if the sector holds a complete header
+ **/
+bool kv_header_valid(int sector) {
+  const kv_header_t* h = (const kv_header_t*)kv_sector(sector);
+  return h->magic == KV_MAGIC && h->seq == ~h->seq_inv;
+}
+
+/**
+ * Walks a sector's log
+ * @param sector 0 or 1
+ * @param key Key to look for
+ * @param found Set to the newest record of key, untouched if there is none
+ * @return Offset of the first free byte, 0 if the log ends in a torn record
+ **/
+uint32_t kv_scan(int sector, uint8_t key, const kv_record_t** found) {
+  const uint8_t* base = kv_sector(sector);
+  uint32_t pos = sizeof(kv_header_t);
+  while (pos + sizeof(kv_record_t) <= FLASH_SECTOR_SIZE) {
+    const kv_record_t* r = (const kv_record_t*)(base + pos);
+    if (r->key == KV_KEY_ERASED) return pos;
+    uint32_t next = pos + sizeof(kv_record_t) + KV_ALIGN(r->len);
+    if (next > FLASH_SECTOR_SIZE ||
+        r->crc != kv_crc(r->key, r->len, (const uint8_t*)(r + 1))) {
+      return 0;
+    }
+    if (r->key == key) *found = r;
+    pos = next;
+  }
+  return pos;
+}
+
+/**
+ * Finds the active sector, only reads flash
+ **/
+void kv_init() {
+  kv_active = -1;
+  kv_tail = 0;
+  for (int i = 0; i < 2; i++) {
+    if (!kv_header_valid(i)) continue;
+    uint32_t seq = ((const kv_header_t*)kv_sector(i))->seq;
+    if (kv_active < 0 || (int32_t)(seq - kv_seq) > 0) {
+      kv_active = i;
+      kv_seq = seq;
+    }
+  }
+  if (kv_active >= 0) {
+    const kv_record_t* r = NULL;
+    kv_tail = kv_scan(kv_active, KV_KEY_ERASED, &r);
+  }
+}
+
+/**
+ * Reads a value
+ * @param key Key
+ * @param len Expected length, records of any other length are ignored
+ * @return Pointer to the value in flash, NULL if it isn't stored
+ **/
+const void* kv_get(uint8_t key, uint8_t len) {
+  const kv_record_t* r = NULL;
+  if (kv_active < 0) return NULL;
+  kv_scan(kv_active, key, &r);
+  return (r != NULL && r->len == len) ? (const void*)(r + 1) : NULL;
+}
+
+/**
+ * Reads a uint8_t value
+ * @param key Key
+ * @param def Value if it isn't stored
+ **/
+uint8_t kv_get_u8(uint8_t key, uint8_t def) {
+  const uint8_t* v = kv_get(key, 1);
+  return v ? *v : def;
+}
+
+/**
+ * Parks core 1 and interrupts while flash is unreadable
+ * @return Interrupt state for kv_flash_end
+ **/
+uint32_t kv_flash_begin() {
+  if (multicore_lockout_victim_is_initialized(1)) {
+    multicore_lockout_start_blocking();
+  }
+  return save_and_disable_interrupts();
+}
+
+void kv_flash_end(uint32_t irq) {
+  restore_interrupts(irq);
+  if (multicore_lockout_victim_is_initialized(1)) {
+    multicore_lockout_end_blocking();
+  }
+}
+
+/**
+ * Programs bytes of a sector, rewriting the rest of each page unchanged
+ * @param sector 0 or 1
+ * @param pos Offset in the sector
+ * @param data Bytes to program
+ * @param len Number of bytes
+ **/
+void kv_program(int sector, uint32_t pos, const uint8_t* data, uint32_t len) {
+  uint8_t page[FLASH_PAGE_SIZE];
+  uint32_t end = pos + len;
+  for (uint32_t p = pos & ~(FLASH_PAGE_SIZE - 1); p < end;
+       p += FLASH_PAGE_SIZE) {
+    memcpy(page, kv_sector(sector) + p, FLASH_PAGE_SIZE);
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+      if (p + i >= pos && p + i < end) page[i] = data[p + i - pos];
+    }
+    uint32_t irq = kv_flash_begin();
+    flash_range_program(KV_OFFSET + sector * FLASH_SECTOR_SIZE + p, page,
+                        FLASH_PAGE_SIZE);
+    kv_flash_end(irq);
+  }
+}
+
+/**
+ * Appends a record to kv_buf
+ * @return New length, 0 if it doesn't fit
+ **/
+uint32_t kv_buf_append(uint32_t pos, uint8_t key, const void* value,
+                       uint8_t len) {
+  uint32_t size = sizeof(kv_record_t) + KV_ALIGN(len);
+  if (pos + size > FLASH_SECTOR_SIZE) return 0;
+  kv_record_t r = {key, len, kv_crc(key, len, value)};
+  memcpy(kv_buf + pos, &r, sizeof(r));
+  memcpy(kv_buf + pos + sizeof(r), value, len);
+  return pos + size;
+}
+
+/**
+ * Rewrites the newest record of every key into the other sector, with key
+ * replaced by value
+ * @return false if the values don't fit a sector
+ **/
+bool kv_compact(uint8_t key, const void* value, uint8_t len) {
+  int target = kv_active < 0 ? 0 : !kv_active;
+  memset(kv_buf, 0xff, sizeof(kv_buf));
+
+  uint32_t pos = sizeof(kv_header_t);
+  for (int k = 0; k < KV_KEY_ERASED && kv_active >= 0; k++) {
+    const kv_record_t* r = NULL;
+    // key gets its new value below, retired keys are left behind
+    if (k == key || k == KV_BOOT_TURBOCHARGER) continue;
+    kv_scan(kv_active, k, &r);
+    if (r == NULL) continue;
+    pos = kv_buf_append(pos, k, r + 1, r->len);
+    if (pos == 0) return false;
+  }
+  pos = kv_buf_append(pos, key, value, len);
+  if (pos == 0) return false;
+
+  uint32_t irq = kv_flash_begin();
+  flash_range_erase(KV_OFFSET + target * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+  kv_flash_end(irq);
+  kv_program(target, sizeof(kv_header_t), kv_buf + sizeof(kv_header_t),
+             pos - sizeof(kv_header_t));
+
+  // The header goes last, it is what makes the new sector count
+  kv_header_t h = {KV_MAGIC, kv_seq + 1, ~(kv_seq + 1)};
+  kv_program(target, 0, (const uint8_t*)&h, sizeof(h));
+  if (!kv_header_valid(target)) return false;
+
+  kv_active = target;
+  kv_seq = h.seq;
+  kv_tail = pos;
+  return true;
+}
+
+/**
+ * Stores a value, flash is only written if it changed
+ * @param key Key, not KV_KEY_ERASED
+ * @param value Value
+ * @param len Length of value
+ * @return false if the value couldn't be written
+ **/
+bool kv_set(uint8_t key, const void* value, uint8_t len) {
+  const void* cur = kv_get(key, len);
+  if (cur != NULL && memcmp(cur, value, len) == 0) return true;
+
+  uint32_t size = sizeof(kv_record_t) + KV_ALIGN(len);
+  if (kv_tail == 0 || kv_tail + size > FLASH_SECTOR_SIZE) {
+    return kv_compact(key, value, len);
+  }
+
+  uint8_t rec[sizeof(kv_record_t) + 256];
+  memset(rec, 0xff, size);
+  kv_record_t r = {key, len, kv_crc(key, len, value)};
+  memcpy(rec, &r, sizeof(r));
+  memcpy(rec + sizeof(r), value, len);
+  kv_program(kv_active, kv_tail, rec, size);
+
+  // Bits which were already programmed can't be set back, verify
+  if (memcmp(kv_sector(kv_active) + kv_tail, rec, size) != 0) {
+    kv_tail = 0;
+    return kv_compact(key, value, len);
+  }
+  kv_tail += size;
+  return true;
+}
+
+/**
+ * Stores a uint8_t value, flash is only written if it changed
+ **/
+bool kv_set_u8(uint8_t key, uint8_t value) { return kv_set(key, &value, 1); }
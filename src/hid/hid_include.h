@@ -0,0 +1,10 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Helpers for building and sending HID reports from the loop modes.
+ **/
+#include "mouse.c"
+#include "nkro.c"
+#include "report_sched.c"
+#include "sof_sync.c"
@@ -0,0 +1,57 @@
+/**
+ * Fixed point mouse output
+ * @author SpeedyPotato
+ *
+ * Encoder counts become mouse counts in Q8: each count is scaled by
+ * config.mouse_sens and by the gain of acceleration curve MOUSE_ACCEL at the
+ * knob's current speed. The part which doesn't make a whole mouse count stays
+ * in mouse_acc for the next report, and so does anything past the -127..127
+ * range of a report. No count is ever lost, gains below 1 work for slow spins
+ * and fast spins come out over the following reports.
+ **/
+#define MOUSE_Q 8
+#define MOUSE_ACCEL_SHIFT 11  // Curve points are 2048 counts/s apart
+#define MOUSE_ACCEL_POINTS 9
+#define MOUSE_REPORT_MAX 127
+
+// Q8 gain by knob speed, linearly interpolated between points
+static const uint16_t mouse_accel_curves[][MOUSE_ACCEL_POINTS] = {
+    {256, 256, 256, 256, 256, 256, 256, 256, 256},  // 0 linear
+    {128, 192, 256, 256, 256, 256, 256, 256, 256},  // 1 precision, slow is 0.5x
+    {256, 256, 320, 384, 448, 512, 576, 640, 704},  // 2 accelerated, up to 2.75x
+};
+
+_Static_assert(MOUSE_ACCEL < count_of(mouse_accel_curves),
+               "MOUSE_ACCEL isn't a curve");
+
+int64_t mouse_acc[2];  // X and Y, Q8 mouse counts not sent yet
+
+/**
+ * @param velocity Knob speed in counts per second
+ * @return Q8 gain of MOUSE_ACCEL at that speed
+ **/
+static inline uint32_t mouse_gain(int32_t velocity) {
+  const uint16_t* curve = mouse_accel_curves[MOUSE_ACCEL];
+  uint32_t speed = velocity < 0 ? -velocity : velocity;
+  uint32_t i = speed >> MOUSE_ACCEL_SHIFT;
+  if (i >= MOUSE_ACCEL_POINTS - 1) return curve[MOUSE_ACCEL_POINTS - 1];
+  int32_t frac = speed & ((1u << MOUSE_ACCEL_SHIFT) - 1);
+  return curve[i] +
+         (((int32_t)curve[i + 1] - curve[i]) * frac >> MOUSE_ACCEL_SHIFT);
+}
+
+/**
+ * Adds encoder counts to an axis and takes out what fits a report
+ * @param acc Axis accumulator, Q8 mouse counts
+ * @param delta Encoder counts since the last report
+ * @param gain Q8 gain
+ * @return Mouse counts for the report, rounded towards 0
+ **/
+static inline int8_t mouse_axis(int64_t* acc, int32_t delta, uint32_t gain) {
+  *acc += (int64_t)delta * config.mouse_sens * gain;
+  int64_t out = *acc / (1 << MOUSE_Q);
+  if (out > MOUSE_REPORT_MAX) out = MOUSE_REPORT_MAX;
+  if (out < -MOUSE_REPORT_MAX) out = -MOUSE_REPORT_MAX;
+  *acc -= out * (1 << MOUSE_Q);
+  return out;
+}
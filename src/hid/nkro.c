@@ -0,0 +1,60 @@
+/**
+ * NKRO keymap
+ * @author SpeedyPotato
+ *
+ * The 32 byte NKRO report is byte 0 = modifiers (keycodes 224-231, sent by
+ * the old builder for 240-247 as well) and bytes 1-31 = one bit per keycode
+ * 0-247. nkro_keymap_build turns config.keycode into the report word and mask
+ * of every switch whenever the keycodes change, so keyboard_report only ORs
+ * the masks of the pressed switches. Keycodes 248-255 have no bit in the
+ * report: SW_KEYCODES is checked here and config_valid turns them away, and
+ * should one get through anyway it gets an empty mask.
+ **/
+#define NKRO_REPORT_SIZE 32
+
+typedef struct {
+  uint8_t word;   // uint32_t index into the report
+  uint32_t mask;  // Bit of the keycode in that word, 0 if none
+} nkro_key_t;
+
+_Static_assert(sizeof(SW_KEYCODE) == SW_GPIO_SIZE,
+               "SW_KEYCODE needs one keycode per switch");
+_Static_assert(SW_GPIO_SIZE <= 32, "Switches are a uint32_t bitmask");
+#define NKRO_KEYCODE_CHECK(k) \
+  _Static_assert((k) < KEYCODE_END, #k " has no bit in the NKRO report");
+SW_KEYCODES(NKRO_KEYCODE_CHECK)
+
+nkro_key_t nkro_keymap[SW_GPIO_SIZE];
+
+/**
+ * Rebuilds nkro_keymap from keycodes
+ * @param keycode Keycode of every switch
+ **/
+void nkro_keymap_build(const uint8_t* keycode) {
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    uint8_t bit = keycode[i] % 8;
+    uint8_t byte = (keycode[i] / 8) + 1;
+    if (keycode[i] >= 240 && keycode[i] <= 247) {
+      byte = 0;
+    } else if (byte >= NKRO_REPORT_SIZE) {
+      nkro_keymap[i] = (nkro_key_t){0, 0};
+      continue;
+    }
+    nkro_keymap[i] = (nkro_key_t){byte / 4, 1u << ((byte % 4) * 8 + bit)};
+  }
+}
+
+/**
+ * Fills in an NKRO report, little endian words
+ * @param nkro Report, cleared first
+ * @param buttons Pressed switches, bit per switch
+ **/
+static inline void nkro_fill(uint32_t nkro[NKRO_REPORT_SIZE / 4],
+                             uint32_t buttons) {
+  for (int i = 0; i < NKRO_REPORT_SIZE / 4; i++) nkro[i] = 0;
+  while (buttons != 0) {
+    const nkro_key_t* k = &nkro_keymap[__builtin_ctz(buttons)];
+    nkro[k->word] |= k->mask;
+    buttons &= buttons - 1;
+  }
+}
@@ -0,0 +1,90 @@
+/**
+ * Change driven report scheduling
+ * @author SpeedyPotato
+ *
+ * A report is only handed to TinyUSB when it differs from the last one sent on
+ * that scheduler, or when the idle interval of the interface ran out. Callers
+ * only try to send when the endpoint is ready and always compare against the
+ * last report which actually went out, so a change made while the endpoint is
+ * busy goes out on the next free slot.
+ *
+ * The idle interval starts at HID_IDLE_TIMEOUT_US and follows HID SET_IDLE
+ * from the host, where 0 means only send on change.
+ *
+ * suppressed counts USB frames in which a ready endpoint had nothing new, at
+ * most one per frame however often the input loop runs, so sent + suppressed
+ * is about the frames the endpoint was free in.
+ **/
+#define REPORT_SCHED_FRAME_US 1000
+
+typedef struct {
+  uint8_t last[CFG_TUD_HID_EP_BUFSIZE];  // Last report sent
+  uint16_t len;                          // 0 until a report was sent
+  uint64_t timestamp;                    // Time the last report was sent
+  uint64_t slot;                         // Frame last sent or suppressed in
+  uint32_t sent;                         // Reports sent
+  uint32_t suppressed;                   // Ready frames skipped, no change
+} report_sched_t;
+
+uint32_t hid_idle_us[CFG_TUD_HID];
+
+/**
+ * Counts a ready slot with nothing to send, once per frame
+ * @param s Scheduler for this report
+ * @param now Current time in us
+ **/
+static inline void report_sched_suppress(report_sched_t* s, uint64_t now) {
+  uint64_t slot = now / REPORT_SCHED_FRAME_US + 1;  // 0 before any slot
+  if (s->slot == slot) return;
+  s->slot = slot;
+  s->suppressed++;
+}
+
+/**
+ * Counts a report sent
+ * @param s Scheduler for this report
+ * @param now Current time in us
+ **/
+static inline void report_sched_sent(report_sched_t* s, uint64_t now) {
+  s->slot = now / REPORT_SCHED_FRAME_US + 1;
+  s->sent++;
+}
+
+/**
+ * Sends a report if it changed or the idle interval ran out
+ * @param s Scheduler for this report
+ * @param instance HID instance
+ * @param report_id Report ID
+ * @param report Report contents
+ * @param len Report length, at most CFG_TUD_HID_EP_BUFSIZE
+ * @param now Current time in us
+ * @return true if the report was sent
+ **/
+bool report_sched_send(report_sched_t* s, uint8_t instance, uint8_t report_id,
+                       void const* report, uint16_t len, uint64_t now) {
+  uint32_t idle = hid_idle_us[instance];
+  if (s->len == len && memcmp(s->last, report, len) == 0 &&
+      (idle == 0 || now - s->timestamp < idle)) {
+    report_sched_suppress(s, now);
+    return false;
+  }
+  if (!tud_hid_n_report(instance, report_id, report, len)) return false;
+
+  memcpy(s->last, report, len);
+  s->len = len;
+  s->timestamp = now;
+  report_sched_sent(s, now);
+  return true;
+}
+
+/**
+ * Forgets the last report so the next one is always sent
+ * @param s Scheduler to reset
+ **/
+static inline void report_sched_reset(report_sched_t* s) { s->len = 0; }
+
+// Invoked when received SET_IDLE request. idle_rate is in 4 ms units
+bool tud_hid_set_idle_cb(uint8_t instance, uint8_t idle_rate) {
+  hid_idle_us[instance] = idle_rate * 4000u;
+  return true;
+}
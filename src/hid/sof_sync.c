@@ -0,0 +1,141 @@
+/**
+ * Start of frame synchronised reports
+ * @author SpeedyPotato
+ *
+ * With USB_SOF_SYNC, TinyUSB calls tud_sof_cb at the start of every USB
+ * frame. The loop keeps sampling and debouncing every iteration, but reports
+ * are only built and queued once per frame, in the last USB_SOF_LEAD_US before
+ * the next SOF, so the IN token finds inputs about USB_SOF_LEAD_US old instead
+ * of anywhere up to 1 ms.
+ *
+ * tud_sof_cb runs from tud_task, so it sees the SOF plus however long the loop
+ * took to get to tud_task. Frames are SOF_PERIOD_US apart on the host's
+ * clock, which may be up to 500 ppm off ours, so both the phase and the
+ * period are estimated, in Q16 us. Callback times are compared with the line
+ * sof_base + frames * sof_period and the earliest one of every
+ * SOF_WINDOW_FRAMES frames is taken as where that line really is, since
+ * callbacks are only ever late. The slope between the earliest points of two
+ * windows corrects the period, SOF_PERIOD_GAIN steps at a time, and the line
+ * is then moved to the newer point. Within a window the estimate only snaps
+ * to callbacks earlier than the line. Without SOFs (suspended, not enumerated)
+ * reports go out every loop as before.
+ **/
+#define SOF_PERIOD_US 1000
+#define SOF_WINDOW_FRAMES 128
+#define SOF_PERIOD_GAIN 4  // Period takes 1/4 of each slope seen
+#define SOF_PERIOD_SLACK_Q16 (1 << 16)  // Period stays within 1 us of 1 ms
+#define SOF_FRAME_MASK 0x7ff            // Frame numbers are 11 bits
+#define SOF_NO_SAMPLE INT32_MIN
+#define SOF_NONE INT64_MAX
+
+bool sof_locked;
+uint64_t sof_timestamp;         // Estimated time of the last SOF
+uint32_t sof_frame;             // Frame number of the last SOF
+uint32_t sof_sent_frame;        // Frame reports were last built for
+uint64_t sof_sample_timestamp;  // When they were built, 0 once used
+
+int64_t sof_base;        // Estimated SOF sof_frames ago, Q16 us
+int64_t sof_period;      // Estimated frame period, Q16 us
+uint32_t sof_frames;     // Frames since the base
+int64_t sof_min;         // Earliest callback this window, relative to line
+uint32_t sof_min_frame;  // Frames since the base of that callback
+bool sof_prev;           // Last window's earliest callback is known
+int64_t sof_prev_min;    // Where it is relative to the line
+int32_t sof_prev_frame;  // Frames since the base of that one, <= 0
+
+/**
+ * Starts over from one callback
+ * @param now Current time in us
+ **/
+static void sof_relock(uint64_t now) {
+  if (!sof_locked) sof_period = (int64_t)SOF_PERIOD_US << 16;
+  sof_base = (int64_t)now << 16;
+  sof_frames = 0;
+  sof_min = SOF_NONE;
+  sof_prev = false;
+  sof_locked = true;
+}
+
+/**
+ * Ends a window: corrects the period from the earliest points of this window
+ * and the last, and moves the line to this window's. A point later than the
+ * line may just be a window of late callbacks, so the line only goes half way
+ * to it.
+ **/
+static void sof_window_end() {
+  if (sof_prev) {
+    // Points close together give a noisy slope, so take it over a window
+    int64_t apart = (int64_t)sof_min_frame - sof_prev_frame;
+    if (apart < SOF_WINDOW_FRAMES) apart = SOF_WINDOW_FRAMES;
+    sof_period += (sof_min - sof_prev_min) / apart / SOF_PERIOD_GAIN;
+    const int64_t nominal = (int64_t)SOF_PERIOD_US << 16;
+    if (sof_period > nominal + SOF_PERIOD_SLACK_Q16) {
+      sof_period = nominal + SOF_PERIOD_SLACK_Q16;
+    } else if (sof_period < nominal - SOF_PERIOD_SLACK_Q16) {
+      sof_period = nominal - SOF_PERIOD_SLACK_Q16;
+    }
+  }
+  int64_t point = sof_base + sof_min_frame * sof_period + sof_min;
+  sof_prev_min = sof_min > 0 ? sof_min / 2 : 0;
+  sof_base = point - sof_prev_min + (sof_frames - sof_min_frame) * sof_period;
+  sof_prev = true;
+  sof_prev_frame = (int32_t)sof_min_frame - (int32_t)sof_frames;
+  sof_frames = 0;
+  sof_min = SOF_NONE;
+}
+
+/**
+ * Tracks the frame phase, call from tud_sof_cb
+ * @param frame_count Frame number of the SOF
+ * @param now Current time in us
+ * @return us from building reports to this SOF, SOF_NO_SAMPLE if none were
+ * built since the last SOF
+ **/
+int32_t sof_update(uint32_t frame_count, uint64_t now) {
+  uint32_t frames = (frame_count - sof_frame) & SOF_FRAME_MASK;
+  int64_t late = 0;
+  if (sof_locked && frames != 0) {
+    sof_frames += frames;
+    late = ((int64_t)now << 16) - (sof_base + sof_frames * sof_period);
+  }
+  if (!sof_locked || frames == 0 ||
+      late >= (int64_t)SOF_PERIOD_US << 15 ||
+      late <= -((int64_t)SOF_PERIOD_US << 15)) {
+    sof_relock(now);
+    late = 0;
+  }
+  if (late < sof_min) {
+    sof_min = late;
+    sof_min_frame = sof_frames;
+  }
+  sof_frame = frame_count;
+  // Later callbacks only move the line at the end of the window
+  int64_t snap = sof_min < 0 ? sof_min : 0;
+  sof_timestamp =
+      (sof_base + sof_frames * sof_period + snap + (1 << 15)) >> 16;
+  if (sof_frames >= SOF_WINDOW_FRAMES) sof_window_end();
+
+  int32_t offset = SOF_NO_SAMPLE;
+  if (sof_sample_timestamp != 0) {
+    offset = (int32_t)(sof_timestamp - sof_sample_timestamp);
+    sof_sample_timestamp = 0;
+  }
+  return offset;
+}
+
+/**
+ * Gate for building reports, call every loop
+ * @param now Current time in us
+ * @return true if reports should be built this loop
+ **/
+bool sof_due(uint64_t now) {
+  if (!sof_locked || now - sof_timestamp >= 2 * SOF_PERIOD_US) return true;
+  uint32_t next = (sof_frame + 1) & SOF_FRAME_MASK;
+  if (next == sof_sent_frame ||
+      now + USB_SOF_LEAD_US < sof_timestamp + SOF_PERIOD_US) {
+    return false;
+  }
+  sof_sent_frame = next;
+  sof_sample_timestamp = now;
+  return true;
+}
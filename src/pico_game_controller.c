@@ -15,28 +15,52 @@
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 #include "hardware/pio.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
 // clang-format off
+#include "sync/sync_include.h"
+#include "config/config_include.h"
+#include "capture/capture_include.h"
 #include "debounce/debounce_include.h"
+#include "encoder/encoder_include.h"
+#include "flash/flash_include.h"
+#include "hid/hid_include.h"
 #include "rgb/rgb_include.h"
+#include "stats/stats_include.h"
 // clang-format on
 
-PIO pio, pio_1;
 uint32_t enc_val[ENC_GPIO_SIZE];
 uint32_t prev_enc_val[ENC_GPIO_SIZE];
 int cur_enc_val[ENC_GPIO_SIZE];
 
-bool sw_prev_raw_val[SW_GPIO_SIZE];
-bool sw_cooked_val[SW_GPIO_SIZE];
+uint32_t sw_raw_val;
+uint32_t sw_prev_raw_val;
+uint32_t sw_cooked_val;
 uint64_t sw_timestamp[SW_GPIO_SIZE];
+uint64_t sw_sample_time;
 
-bool kbm_report;
+const uint32_t sw_gpio_mask = SW_GPIO_MASK;
+uint32_t sw_gather_lut[4][256];
+const uint32_t led_gpio_mask = LED_GPIO_MASK;
+uint32_t led_scatter_lut[(LED_GPIO_SIZE + 7) / 8][256];
+
+report_sched_t joy_sched;
+report_sched_t keyboard_sched;
+report_sched_t mouse_sched;
+report_sched_t* const report_scheds[] = {&joy_sched, &keyboard_sched,
+                                         &mouse_sched};
 
 uint64_t reactive_timeout_timestamp;
 
+#define INPUT_SCHED_ALARM 2  // Hardware alarm, the default pool uses 3
+alarm_pool_t* input_pool;
+repeating_timer_t input_timer;
+volatile bool input_pass_done;  // Set by each scheduled pass, main clears it
+
 void (*ws2812b_mode)();
 void (*loop_mode)();
 void (*debounce_mode)();
@@ -49,141 +73,367 @@ union {
   } lights;
   uint8_t raw[LED_GPIO_SIZE + WS2812B_LED_ZONES * 3];
 } lights_report;
+uint32_t lights_report_buttons;
+
+seqlock_t lights_lock;
+lights_state_t lights_shared;  // Written by core 0 under lights_lock
+lights_state_t lights_state;   // Core 1's copy for the current frame
+
+/**
+ * Publish encoder counts to core 1, only when they moved. Bumping the lock
+ * every pass would leave core 1 almost no window to copy in.
+ **/
+void publish_lights_state() {
+  uint32_t val[ENC_GPIO_SIZE];
+  bool changed = false;
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    val[i] = enc_val[i];  // DMA keeps writing, read each count once
+    changed |= val[i] != lights_shared.enc_val[i];
+  }
+  if (!changed) return;
+
+  seqlock_write_begin(&lights_lock);
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    lights_shared.enc_val[i] = val[i];
+  }
+  seqlock_write_end(&lights_lock);
+}
+
+/**
+ * Build the GPIO order <-> button order lookup tables out of SW_GPIO and
+ * LED_GPIO. Each table maps one byte of a bitmask, so a remap is a fixed
+ * number of lookups no matter how many switches or LEDs there are.
+ **/
+void init_gpio_lut() {
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    for (int v = 0; v < 256; v++) {
+      if (v & (1u << (SW_GPIO[i] % 8))) {
+        sw_gather_lut[SW_GPIO[i] / 8][v] |= 1u << i;
+      }
+    }
+  }
+  for (int i = 0; i < LED_GPIO_SIZE; i++) {
+    for (int v = 0; v < 256; v++) {
+      if (v & (1u << (i % 8))) {
+        led_scatter_lut[i / 8][v] |= 1u << LED_GPIO[i];
+      }
+    }
+  }
+}
+
+/**
+ * Remap a GPIO bitmask to button order
+ * @param gpio Bitmask indexed by GPIO number
+ **/
+static inline uint32_t sw_gather(uint32_t gpio) {
+  return sw_gather_lut[0][gpio & 0xff] | sw_gather_lut[1][(gpio >> 8) & 0xff] |
+         sw_gather_lut[2][(gpio >> 16) & 0xff] | sw_gather_lut[3][gpio >> 24];
+}
+
+/**
+ * Remap a button order bitmask to LED GPIOs
+ * @param buttons Bitmask indexed by LED number
+ **/
+static inline uint32_t led_scatter(uint32_t buttons) {
+  uint32_t gpio = 0;
+  for (int i = 0; i < (LED_GPIO_SIZE + 7) / 8; i++) {
+    gpio |= led_scatter_lut[i][(buttons >> (i * 8)) & 0xff];
+  }
+  return gpio;
+}
 
 /**
  * WS2812B Lighting
  * @param counter Current number of WS2812B cycles
  **/
 void ws2812b_update(uint32_t counter) {
-  if (time_us_64() - reactive_timeout_timestamp >= REACTIVE_TIMEOUT_MAX) {
+  // Take a consistent snapshot, keep the last one if core 0 kept writing
+  lights_state_t state;
+  for (int tries = 0; tries < 4; tries++) {
+    if (seqlock_read(&lights_lock, &state, &lights_shared, sizeof(state))) {
+      lights_state = state;
+      break;
+    }
+  }
+
+  pixels_fetch();
+
+  // Whichever HID lighting report came last wins until it times out
+  uint64_t now = time_us_64();
+  if (now - pixels_frame->timestamp < config.reactive_timeout_us &&
+      pixels_frame->timestamp >= lights_state.reactive_timeout_timestamp) {
+    for (int i = 0; i < WS2812B_LED_SIZE; i++) {
+      put_pixel(urgb_u32(pixels_frame->rgb[i].r, pixels_frame->rgb[i].g,
+                         pixels_frame->rgb[i].b));
+    }
+  } else if (now - lights_state.reactive_timeout_timestamp >=
+             config.reactive_timeout_us) {
     ws2812b_mode(counter);
   } else {
     for (int i = 0; i < WS2812B_LED_ZONES; i++) {
       for (int j = 0; j < WS2812B_LEDS_PER_ZONE; j++) {
-        put_pixel(urgb_u32(lights_report.lights.rgb[i].r,
-                           lights_report.lights.rgb[i].g,
-                           lights_report.lights.rgb[i].b));
+        put_pixel(urgb_u32(lights_state.rgb[i].r, lights_state.rgb[i].g,
+                           lights_state.rgb[i].b));
       }
     }
   }
+  ws2812b_show();
 }
 
 /**
  * HID/Reactive Lights
  **/
 void update_lights() {
-  for (int i = 0; i < LED_GPIO_SIZE; i++) {
-    if (time_us_64() - reactive_timeout_timestamp >= REACTIVE_TIMEOUT_MAX) {
-      if (!gpio_get(SW_GPIO[i])) {
-        gpio_put(LED_GPIO[i], 1);
-      } else {
-        gpio_put(LED_GPIO[i], 0);
-      }
-    } else {
-      if (lights_report.lights.buttons[i] == 0) {
-        gpio_put(LED_GPIO[i], 0);
-      } else {
-        gpio_put(LED_GPIO[i], 1);
-      }
-    }
+  uint32_t leds;
+  if (sw_sample_time - reactive_timeout_timestamp >=
+      config.reactive_timeout_us) {
+    leds = sw_raw_val;
+  } else {
+    leds = lights_report_buttons;
   }
+  gpio_put_masked(led_gpio_mask, led_scatter(leds));
 }
 
-struct report {
+_Static_assert(JOY_AXIS_BITS == 8 || JOY_AXIS_BITS == 16,
+               "JOY_AXIS_BITS must be 8 or 16");
+#if JOY_AXIS_BITS > 8
+typedef uint16_t joy_axis_t;
+#else
+typedef uint8_t joy_axis_t;
+#endif
+_Static_assert(((uint64_t)ENC_PULSE << JOY_AXIS_BITS) <= UINT32_MAX,
+               "ENC_PULSE too large for JOY_AXIS_BITS");
+
+// Packed, 8 bit axes and an odd number of encoders would pad the end
+struct TU_ATTR_PACKED report {
   uint16_t buttons;
-  uint8_t joy0;
-  uint8_t joy1;
+  joy_axis_t joy[ENC_GPIO_SIZE];
 } report;
+_Static_assert(sizeof(report) == 2 + ENC_GPIO_SIZE * JOY_AXIS_BITS / 8,
+               "Gamepad report doesn't match its HID report descriptor");
+
+/**
+ * Encoder position to gamepad axis, floor(pos * 2^JOY_AXIS_BITS / ENC_PULSE).
+ * Cortex-M0+ has no UMULL to turn the constant divisor into a multiply, so
+ * this compiles to __aeabi_uidiv, which the SDK routes to the hardware
+ * divider. Every position in [0, ENC_PULSE) maps to exactly one axis value
+ * with no rollover bias.
+ * @param pos Encoder position in [0, ENC_PULSE)
+ **/
+static inline joy_axis_t enc_axis(int pos) {
+  return ((uint32_t)pos << JOY_AXIS_BITS) / ENC_PULSE;
+}
 
 /**
  * Gamepad Mode
  **/
 void joy_mode() {
-  if (tud_hid_ready()) {
+  if (tud_hid_n_ready(ITF_NUM_HID)) {
     // find the delta between previous and current enc_val
     for (int i = 0; i < ENC_GPIO_SIZE; i++) {
-      cur_enc_val[i] +=
-          ((ENC_REV[i] ? 1 : -1) * (enc_val[i] - prev_enc_val[i]));
-      while (cur_enc_val[i] < 0) cur_enc_val[i] = ENC_PULSE + cur_enc_val[i];
-      cur_enc_val[i] %= ENC_PULSE;
+      uint32_t val = enc_val[i];
+      int32_t delta = (int32_t)(val - prev_enc_val[i]);
+      prev_enc_val[i] = val;
+
+      cur_enc_val[i] = (cur_enc_val[i] + (enc_rev(i) ? delta : -delta)) %
+                       ENC_PULSE;
+      if (cur_enc_val[i] < 0) cur_enc_val[i] += ENC_PULSE;
+    }
+
+    if (ENC_PREDICT_US > 0) {
+      // Report where the knobs will be by the time the host reads the report
+      int pos[ENC_GPIO_SIZE];
+      for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+        int32_t ahead = enc_predict(i, ENC_PREDICT_US);
+        pos[i] = (cur_enc_val[i] + (enc_rev(i) ? ahead : -ahead)) % ENC_PULSE;
+        if (pos[i] < 0) pos[i] += ENC_PULSE;
+      }
+      for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+        report.joy[i] = enc_axis(pos[i]);
+      }
+    } else {
+      for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+        report.joy[i] = enc_axis(cur_enc_val[i]);
+      }
+    }
 
-      prev_enc_val[i] = enc_val[i];
+    if (report_sched_send(&joy_sched, ITF_NUM_HID, REPORT_ID_JOYSTICK, &report,
+                          sizeof(report), sw_sample_time)) {
+      hist_interval(HIST_REPORT, time_us_32());
+      stats_report(report.buttons, time_us_64());
     }
+  }
+}
 
-    report.joy0 = ((double)cur_enc_val[0] / ENC_PULSE) * (UINT8_MAX + 1);
-    report.joy1 = ((double)cur_enc_val[1] / ENC_PULSE) * (UINT8_MAX + 1);
+/**
+ * Keyboard Report
+ * @return true if a report was sent
+ **/
+bool keyboard_report() {
+  uint32_t nkro_report[NKRO_REPORT_SIZE / 4];
+  nkro_fill(nkro_report, report.buttons);
+  if (!report_sched_send(&keyboard_sched, ITF_NUM_HID, REPORT_ID_KEYBOARD,
+                         &nkro_report, sizeof(nkro_report), sw_sample_time)) {
+    return false;
+  }
+  hist_interval(HIST_REPORT, time_us_32());
+  stats_report(report.buttons, time_us_64());
+  return true;
+}
 
-    tud_hid_n_report(0x00, REPORT_ID_JOYSTICK, &report, sizeof(report));
+/**
+ * Mouse Report, only sent when an encoder moved
+ * @return true if a report was sent
+ **/
+bool mouse_report() {
+  // find the delta between previous and current enc_val
+  // X and Y come from the first 2 encoders, 0 if there is only one
+  // Counts are only taken out of prev_enc_val and mouse_acc once sent
+  uint32_t val[ENC_GPIO_SIZE];
+  int64_t acc[2] = {mouse_acc[0], mouse_acc[1]};
+  int8_t xy[2] = {0};
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    val[i] = enc_val[i];
+    if (i < 2) {
+      int32_t delta =
+          (int32_t)(val[i] - prev_enc_val[i]) * (enc_rev(i) ? 1 : -1);
+      xy[i] = mouse_axis(&acc[i], delta, mouse_gain(enc_vel[i].velocity));
+    }
+  }
+  if (xy[0] == 0 && xy[1] == 0) {
+    report_sched_suppress(&mouse_sched, sw_sample_time);
+    return false;
+  }
+  if (!tud_hid_n_mouse_report(ITF_NUM_HID_MOUSE, REPORT_ID_MOUSE, 0x00, xy[0],
+                              xy[1], 0, 0)) {
+    return false;
   }
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    prev_enc_val[i] = val[i];
+  }
+  mouse_acc[0] = acc[0];
+  mouse_acc[1] = acc[1];
+  report_sched_sent(&mouse_sched, sw_sample_time);
+  return true;
 }
 
 /**
  * Keyboard Mode
+ * Keyboard and mouse are on separate interfaces, each sends whenever its own
+ * endpoint is ready.
  **/
 void key_mode() {
-  if (tud_hid_ready()) {  // Wait for ready, updating mouse too fast hampers
-                          // movement
-    if (kbm_report) {
-      /*------------- Keyboard -------------*/
-      uint8_t nkro_report[32] = {0};
-      for (int i = 0; i < SW_GPIO_SIZE; i++) {
-        if ((report.buttons >> i) % 2 == 1) {
-          uint8_t bit = SW_KEYCODE[i] % 8;
-          uint8_t byte = (SW_KEYCODE[i] / 8) + 1;
-          if (SW_KEYCODE[i] >= 240 && SW_KEYCODE[i] <= 247) {
-            nkro_report[0] |= (1 << bit);
-          } else if (byte > 0 && byte <= 31) {
-            nkro_report[byte] |= (1 << bit);
-          }
-        }
-      }
-      tud_hid_n_report(0x00, REPORT_ID_KEYBOARD, &nkro_report,
-                       sizeof(nkro_report));
-    } else {
-      /*------------- Mouse -------------*/
-      // find the delta between previous and current enc_val
-      int delta[ENC_GPIO_SIZE] = {0};
-      for (int i = 0; i < ENC_GPIO_SIZE; i++) {
-        delta[i] = (enc_val[i] - prev_enc_val[i]) * (ENC_REV[i] ? 1 : -1);
-        prev_enc_val[i] = enc_val[i];
-      }
+  if (tud_hid_n_ready(ITF_NUM_HID)) {
+    keyboard_report();
+  }
+  if (tud_hid_n_ready(ITF_NUM_HID_MOUSE)) {
+    mouse_report();
+  }
+}
+
+/**
+ * Takes one snapshot of every switch for this loop.
+ * Note: Switches are pull up, negate value
+ **/
+void sample_inputs() {
+  sw_raw_val = sw_gather(~gpio_get_all() & sw_gpio_mask);
+  sw_sample_time = time_us_64();
+}
 
-      tud_hid_mouse_report(REPORT_ID_MOUSE, 0x00, delta[0] * MOUSE_SENS,
-                           delta[1] * MOUSE_SENS, 0, 0);
+/**
+ * Samples switches and runs the debounce mode over them. With edge capture
+ * the debounce mode runs once per captured edge at the time of the edge, then
+ * once more at the current time.
+ **/
+void debounce_inputs() {
+  if (sw_capture_active) {
+    uint32_t state;
+    uint64_t time;
+    while (sw_capture_pop(&state, &time)) {
+      sw_raw_val = sw_gather(~state & sw_gpio_mask);
+      if (sw_raw_val == sw_prev_raw_val) continue;  // Not a switch pin
+      sw_sample_time = time;
+      debounce_mode();
+      debounce_metrics_update();
+      sw_prev_raw_val = sw_raw_val;
     }
-    // Alternate reports
-    kbm_report = !kbm_report;
+    sw_sample_time = time_us_64();
+  } else {
+    sample_inputs();
   }
+  debounce_mode();
+  debounce_metrics_update();
 }
 
 /**
  * Updates input states and stores true state into report.buttons.
- * Note: Switches are pull up, negate value
  **/
 void update_inputs() {
-  report.buttons = 0;
-  for (int i = SW_GPIO_SIZE - 1; i >= 0; i--) {
-    sw_prev_raw_val[i] = !gpio_get(SW_GPIO[i]);
+  sw_prev_raw_val = sw_raw_val;
+  report.buttons = sw_cooked_val;
+  stats_input(sw_raw_val, sw_sample_time);
+}
 
-    report.buttons <<= 1;
-    report.buttons |= sw_cooked_val[i];
+/**
+ * USB, switches and reports for one pass
+ **/
+void input_task() {
+  uint32_t start = hist_lap(HIST_LOOP);
+
+  tud_task();  // tinyusb device task
+  hist_span(HIST_TUD_TASK, start);
+
+  uint32_t debounce_start = hist_cycles();
+  debounce_inputs();
+  hist_span(HIST_DEBOUNCE, debounce_start);
+  update_inputs();
+  enc_velocity_update(sw_sample_time);
+  if (!USB_SOF_SYNC || sof_due(sw_sample_time)) {
+    loop_mode();
   }
+  publish_lights_state();
+  stats_loop(sw_sample_time);
+}
+
+/**
+ * Scheduled input pass
+ * @param rt Repeating timer, unused
+ **/
+bool input_timer_cb(repeating_timer_t* rt) {
+  (void)rt;
+  stats_sched(time_us_64(), USB_SCHED_PERIOD_US);
+  input_task();
+  input_pass_done = true;
+  return true;
 }
 
 /**
- * DMA Encoder Logic For 2 Encoders
+ * Run input_task from a timer every USB_SCHED_PERIOD_US instead of the main
+ * loop, so lights can't delay it. The timer IRQ gets the same priority as the
+ * USB IRQ: above everything else, but never preempting the USB IRQ while it
+ * queues events for tud_task.
+ **/
+void input_sched_init() {
+  input_pool = alarm_pool_create(INPUT_SCHED_ALARM, 1);
+  irq_set_priority(TIMER_IRQ_0 + INPUT_SCHED_ALARM, PICO_HIGHEST_IRQ_PRIORITY);
+  irq_set_priority(USBCTRL_IRQ, PICO_HIGHEST_IRQ_PRIORITY);
+  // Negative delay keeps the period start to start
+  alarm_pool_add_repeating_timer_us(input_pool, -USB_SCHED_PERIOD_US,
+                                    input_timer_cb, NULL, &input_timer);
+}
+
+/**
+ * DMA Encoder Logic, restarts every encoder channel which finished
  **/
 void dma_handler() {
-  uint i = 1;
-  int interrupt_channel = 0;
-  while ((i & dma_hw->ints0) == 0) {
-    i = i << 1;
-    ++interrupt_channel;
-  }
-  dma_hw->ints0 = 1u << interrupt_channel;
-  if (interrupt_channel < 4) {
-    dma_channel_set_read_addr(interrupt_channel, &pio->rxf[interrupt_channel],
-                              true);
+  uint32_t ints = dma_hw->ints0;
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    uint32_t mask = 1u << enc_slot[i].dma;
+    if (ints & mask) {
+      dma_hw->ints0 = mask;
+      dma_channel_set_read_addr(enc_slot[i].dma, enc_rxf[i], true);
+      enc_dma_irqs++;
+    }
   }
 }
 
@@ -192,10 +442,61 @@ void dma_handler() {
  **/
 void core1_entry() {
   uint32_t counter = 0;
+  multicore_lockout_victim_init();  // Parked while core 0 writes flash
+  hist_init();
+  absolute_time_t deadline = get_absolute_time();
   while (1) {
+    uint32_t start = hist_cycles();
     ws2812b_update(++counter);
-    sleep_ms(5);
+    hist_span(HIST_RENDER, start);
+
+    // Frames start on a fixed WS2812B_FRAME_US grid, so render time doesn't
+    // stretch the period. A frame which overran its budget drops the frames
+    // it ran into and counter skips them, so effects keep their speed and
+    // only render less often.
+    deadline = delayed_by_us(deadline, WS2812B_FRAME_US);
+    int64_t late = absolute_time_diff_us(deadline, get_absolute_time());
+    if (late >= 0) {
+      uint32_t dropped = late / WS2812B_FRAME_US + 1;
+      deadline = delayed_by_us(deadline, (uint64_t)dropped * WS2812B_FRAME_US);
+      counter += dropped;
+      ws2812b_frames_dropped += dropped;
+    }
+    sleep_until(deadline);
+  }
+}
+
+/**
+ * Loads config from flash, or the defaults if nothing valid is saved
+ **/
+void config_load() {
+  const config_t* saved = kv_get(KV_CONFIG, CONFIG_SIZE);
+  config_default(&config);
+  if (saved != NULL) {
+    config_t c = config;
+    memcpy(&c, saved, CONFIG_SIZE);
+    if (config_valid(&c, count_of(debounce_modes), count_of(ws2812b_modes))) {
+      config = c;
+    }
+  }
+}
+
+/**
+ * Saves config to flash, only written if it changed
+ **/
+void config_save() { kv_set(KV_CONFIG, &config, CONFIG_SIZE); }
+
+/**
+ * Switches to the modes selected in config. A switch bouncing right as the
+ * debounce mode changes can let one bounce through.
+ **/
+void config_apply() {
+  if (debounce_mode != debounce_modes[config.debounce_mode]) {
+    debounce_metrics_reset();
   }
+  debounce_mode = debounce_modes[config.debounce_mode];
+  ws2812b_mode = ws2812b_modes[config.ws2812b_mode];
+  nkro_keymap_build(config.keycode);
 }
 
 /**
@@ -207,49 +508,107 @@ void init() {
   gpio_set_dir(25, GPIO_OUT);
   gpio_put(25, 1);
 
-  // Set up the state machine for encoders
-  pio = pio0;
-  uint offset = pio_add_program(pio, &encoders_program);
+  // Set up WS2812B
+  for (int i = 0; i < WS2812B_STRIPS; i++) {
+    if (ws2812b_pin_taken(WS2812B_GPIO + i)) {
+      panic("WS2812B strip %d shares GPIO %d", i, WS2812B_GPIO + i);
+    }
+  }
+  uint ws2812b_sm = pio_claim_unused_sm(pio1, true);
+  if (WS2812B_STRIPS > 1) {
+    uint offset2 = pio_add_program(pio1, &ws2812_parallel_program);
+    ws2812_parallel_program_init(pio1, ws2812b_sm, offset2, WS2812B_GPIO,
+                                 WS2812B_STRIPS, 800000);
+  } else {
+    uint offset2 = pio_add_program(pio1, &ws2812_program);
+    ws2812_program_init(pio1, ws2812b_sm, offset2, WS2812B_GPIO, 800000,
+                        false);
+  }
+  ws2812b_init(pio1, ws2812b_sm);
+
+  // Set up the state machines for encoders on whichever PIOs have room
+  uint8_t free_sm[NUM_PIOS] = {0};
+  bool fits[NUM_PIOS];
+  int offset[NUM_PIOS] = {-1, -1};
+  for (int p = 0; p < NUM_PIOS; p++) {
+    for (int sm = 0; sm < 4; sm++) {
+      if (!pio_sm_is_claimed(pio_get_instance(p), sm)) free_sm[p] |= 1u << sm;
+    }
+    fits[p] = pio_can_add_program(pio_get_instance(p), &encoders_program);
+  }
+  if (!enc_alloc(ENC_GPIO_SIZE, free_sm, fits, enc_slot)) {
+    panic("No state machines left for encoders");
+  }
 
   // Setup Encoders
   for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    PIO pio = pio_get_instance(enc_slot[i].pio);
+    uint sm = enc_slot[i].sm;
+    if (offset[enc_slot[i].pio] < 0) {
+      offset[enc_slot[i].pio] = pio_add_program(pio, &encoders_program);
+    }
     enc_val[i] = prev_enc_val[i] = cur_enc_val[i] = 0;
-    encoders_program_init(pio, i, offset, ENC_GPIO[i], ENC_DEBOUNCE);
-
-    dma_channel_config c = dma_channel_get_default_config(i);
+    pio_sm_claim(pio, sm);
+    enc_slot[i].dma = dma_claim_unused_channel(true);
+    enc_slot[i].ctrl = ENC_DMA_CHAIN ? dma_claim_unused_channel(false) : -1;
+    enc_rxf[i] = &pio->rxf[sm];
+    encoders_program_init(pio, sm, offset[enc_slot[i].pio], ENC_GPIO[i],
+                          ENC_DEBOUNCE);
+
+    dma_channel_config c = dma_channel_get_default_config(enc_slot[i].dma);
     channel_config_set_read_increment(&c, false);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_dreq(&c, pio_get_dreq(pio, i, false));
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    if (enc_slot[i].ctrl >= 0) {
+      channel_config_set_chain_to(&c, enc_slot[i].ctrl);
+    }
 
-    dma_channel_configure(i, &c,
-                          &enc_val[i],   // Destination pointer
-                          &pio->rxf[i],  // Source pointer
-                          0x10,          // Number of transfers
-                          true           // Start immediately
+    dma_channel_configure(enc_slot[i].dma, &c,
+                          &enc_val[i],  // Destination pointer
+                          enc_rxf[i],   // Source pointer
+                          enc_slot[i].ctrl >= 0 ? ENC_DMA_CHAIN_TRANSFERS
+                                                : ENC_DMA_IRQ_TRANSFERS,
+                          false         // Start below
     );
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
-    irq_set_enabled(DMA_IRQ_0, true);
-    dma_channel_set_irq0_enabled(i, true);
+
+    if (enc_slot[i].ctrl >= 0) {
+      // Writes the FIFO address to the read address trigger of the data
+      // channel, which restarts it with a full transfer count
+      dma_channel_config cc = dma_channel_get_default_config(enc_slot[i].ctrl);
+      channel_config_set_read_increment(&cc, false);
+      channel_config_set_write_increment(&cc, false);
+      dma_channel_configure(
+          enc_slot[i].ctrl, &cc,
+          &dma_channel_hw_addr(enc_slot[i].dma)->al3_read_addr_trig,
+          &enc_rxf[i],  // Source pointer
+          1,            // Number of transfers
+          false         // Started by the data channel
+      );
+    } else {
+      dma_channel_set_irq0_enabled(enc_slot[i].dma, true);
+    }
+    dma_channel_start(enc_slot[i].dma);
   }
+  irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
+  irq_set_enabled(DMA_IRQ_0, true);
 
   reactive_timeout_timestamp = time_us_64();
-
-  // Set up WS2812B
-  pio_1 = pio1;
-  uint offset2 = pio_add_program(pio_1, &ws2812_program);
-  ws2812_program_init(pio_1, ENC_GPIO_SIZE, offset2, WS2812B_GPIO, 800000,
-                      false);
+  lights_shared.reactive_timeout_timestamp = reactive_timeout_timestamp;
 
   // Setup Button GPIO
+  init_gpio_lut();
+  sw_raw_val = sw_prev_raw_val = sw_cooked_val = 0;
   for (int i = 0; i < SW_GPIO_SIZE; i++) {
-    sw_prev_raw_val[i] = false;
-    sw_cooked_val[i] = false;
     sw_timestamp[i] = 0;
     gpio_init(SW_GPIO[i]);
     gpio_set_function(SW_GPIO[i], GPIO_FUNC_SIO);
     gpio_set_dir(SW_GPIO[i], GPIO_IN);
     gpio_pull_up(SW_GPIO[i]);
   }
+  sample_inputs();
+  if (SW_EDGE_CAPTURE) {
+    if (!sw_capture_init(pio1)) sw_capture_init(pio0);
+  }
 
   // Setup LED GPIO
   for (int i = 0; i < LED_GPIO_SIZE; i++) {
@@ -257,11 +616,23 @@ void init() {
     gpio_set_dir(LED_GPIO[i], GPIO_OUT);
   }
 
-  // Set listener bools
-  kbm_report = false;
+  // HID idle intervals until the host sends SET_IDLE
+  for (int i = 0; i < CFG_TUD_HID; i++) {
+    hid_idle_us[i] = HID_IDLE_TIMEOUT_US;
+  }
+
+  // Boot modes are saved in flash, hold a button while plugging in to toggle.
+  // Flash is only written on a toggle, not on every boot.
+  kv_init();
+  bool key_mode_held = !gpio_get(SW_GPIO[0]);
+  bool rgb_off_held = !gpio_get(SW_GPIO[8]);
+  uint8_t boot_key_mode = kv_get_u8(KV_BOOT_KEY_MODE, false) ^ key_mode_held;
+  uint8_t boot_rgb_off = kv_get_u8(KV_BOOT_RGB_OFF, false) ^ rgb_off_held;
+  if (key_mode_held) kv_set_u8(KV_BOOT_KEY_MODE, boot_key_mode);
+  if (rgb_off_held) kv_set_u8(KV_BOOT_RGB_OFF, boot_rgb_off);
 
   // Joy/KB Mode Switching
-  if (!gpio_get(SW_GPIO[0])) {
+  if (boot_key_mode) {
     loop_mode = &key_mode;
     joy_mode_check = false;
   } else {
@@ -269,36 +640,69 @@ void init() {
     joy_mode_check = true;
   }
 
-  // RGB Mode Switching
+  // Runtime settings, the saved ones replace controller_config.h
+  config_load();
+
+  // RGB Mode Switching, toggles between color cycle and turbocharger
   if (!gpio_get(SW_GPIO[1])) {
-    ws2812b_mode = &turbocharger_color_cycle;
-  } else {
-    ws2812b_mode = &ws2812b_color_cycle;
+    config.ws2812b_mode = config.ws2812b_mode == 1 ? 0 : 1;
+    config_save();
   }
-
-  // Debouncing Mode
-  debounce_mode = &debounce_eager;
+  config_apply();
 
   // Disable RGB
-  if (gpio_get(SW_GPIO[8])) {
+  if (!boot_rgb_off) {
     multicore_launch_core1(core1_entry);
   }
 }
 
+// Invoked when a report was sent to the host
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report,
+                                uint16_t len) {
+  (void)report;
+  (void)len;
+  stats_report_complete(instance);
+}
+
+// Invoked at every USB frame once enabled with tud_sof_cb_enable
+void tud_sof_cb(uint32_t frame_count) {
+  stats_sof(sof_update(frame_count, time_us_64()));
+}
+
+// Invoked when device is mounted, resend every report to the new host
+void tud_mount_cb(void) {
+  report_sched_reset(&joy_sched);
+  report_sched_reset(&keyboard_sched);
+}
+
 /**
  * Main Loop Function
  **/
 int main(void) {
   board_init();
+  hist_init();
   init();
   tusb_init();
+  if (USB_SOF_SYNC) {
+    tud_sof_cb_enable(true);
+  }
+  if (USB_SCHED_PERIOD_US > 0) {
+    input_sched_init();
+  }
 
   while (1) {
-    tud_task();  // tinyusb device task
-    debounce_mode();
-    update_inputs();
-    loop_mode();
-    update_lights();
+    if (USB_SCHED_PERIOD_US > 0) {
+      // Lights once per scheduled pass, the timer owns USB and inputs. Other
+      // IRQs (USB, DMA) also end __wfi, so wait for the pass itself.
+      while (!input_pass_done) __wfi();
+      input_pass_done = false;
+      uint32_t irq = save_and_disable_interrupts();
+      update_lights();
+      restore_interrupts(irq);
+    } else {
+      input_task();
+      update_lights();
+    }
   }
 
   return 0;
@@ -310,13 +714,22 @@ int main(void) {
 uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id,
                                hid_report_type_t report_type, uint8_t* buffer,
                                uint16_t reqlen) {
-  // TODO not Implemented
   (void)itf;
-  (void)report_id;
-  (void)report_type;
-  (void)buffer;
-  (void)reqlen;
-
+  if (report_id == REPORT_ID_STATS && report_type == HID_REPORT_TYPE_FEATURE) {
+    return hist_get_report(buffer, reqlen);
+  }
+  if (report_id == REPORT_ID_CONFIG && report_type == HID_REPORT_TYPE_FEATURE) {
+    return config_get_report(buffer, reqlen);
+  }
+  if (report_id == REPORT_ID_DEBOUNCE &&
+      report_type == HID_REPORT_TYPE_FEATURE) {
+    return debounce_get_report(buffer, reqlen);
+  }
+  if (report_id == REPORT_ID_LATENCY &&
+      report_type == HID_REPORT_TYPE_FEATURE) {
+    return latency_get_report(buffer, reqlen, report_scheds,
+                              count_of(report_scheds));
+  }
   return 0;
 }
 
@@ -326,13 +739,55 @@ void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id,
                            hid_report_type_t report_type, uint8_t const* buffer,
                            uint16_t bufsize) {
   (void)itf;
-  if (report_id == 2 && report_type == HID_REPORT_TYPE_OUTPUT &&
+  // Every report has an ID, so ID 0 means the OUT endpoint, where the data
+  // still starts with the report ID. Not every TinyUSB passes the same type.
+  if (report_id == 0 && bufsize > 0) {
+    report_id = buffer[0];
+    report_type = HID_REPORT_TYPE_OUTPUT;
+    buffer++;
+    bufsize--;
+  }
+
+  if (report_id == REPORT_ID_STATS && report_type == HID_REPORT_TYPE_FEATURE) {
+    hist_set_report(buffer, bufsize);
+  } else if (report_id == REPORT_ID_CONFIG &&
+             report_type == HID_REPORT_TYPE_FEATURE &&
+             bufsize >= CONFIG_REPORT_SIZE) {
+    config_t c;
+    memcpy(&c, &buffer[1], CONFIG_SIZE);
+    if (config_valid(&c, count_of(debounce_modes), count_of(ws2812b_modes))) {
+      config = c;
+      config_apply();
+      if (buffer[0] & CONFIG_SAVE) config_save();
+    }
+  } else if (report_id == REPORT_ID_DEBOUNCE &&
+             report_type == HID_REPORT_TYPE_FEATURE) {
+    debounce_set_report(buffer, bufsize);
+  } else if (report_id == REPORT_ID_LATENCY &&
+             report_type == HID_REPORT_TYPE_FEATURE) {
+    latency_set_report(buffer, bufsize, report_scheds,
+                       count_of(report_scheds));
+  } else if (report_id == REPORT_ID_PIXELS &&
+             report_type == HID_REPORT_TYPE_OUTPUT) {
+    if (pixels_apply(buffer, bufsize)) pixels_show();
+  } else if (report_id == 2 && report_type == HID_REPORT_TYPE_OUTPUT &&
       bufsize >= sizeof(lights_report))  // light data
   {
     size_t i = 0;
     for (i; i < sizeof(lights_report); i++) {
       lights_report.raw[i] = buffer[i];
     }
+    lights_report_buttons = 0;
+    for (i = 0; i < LED_GPIO_SIZE; i++) {
+      lights_report_buttons |= (uint32_t)(lights_report.lights.buttons[i] != 0)
+                               << i;
+    }
     reactive_timeout_timestamp = time_us_64();
+
+    seqlock_write_begin(&lights_lock);
+    memcpy(lights_shared.rgb, lights_report.lights.rgb,
+           sizeof(lights_shared.rgb));
+    lights_shared.reactive_timeout_timestamp = reactive_timeout_timestamp;
+    seqlock_write_end(&lights_lock);
   }
 }
@@ -0,0 +1,85 @@
+/**
+ * Per LED lighting over HID
+ * @author SpeedyPotato
+ *
+ * REPORT_ID_PIXELS output reports carry runs of pixels, so a host only sends
+ * the LEDs which changed and a strip of any length fits in 63 byte reports.
+ * Byte 0 = flags, then runs of {start, n}:
+ * - n & PIXELS_FILL: one r, g, b for the (n & 0x7f) pixels from start
+ * - otherwise: n r, g, b triples for the n pixels from start
+ * A run with n == 0 or the end of the report ends the list.
+ *
+ * Runs go into a staging frame on core 0, which is only handed to core 1 by a
+ * report with PIXELS_SHOW, so a frame split over several reports never shows
+ * half updated. Pixels keep their value between frames, a pixel which didn't
+ * change never has to be sent again.
+ *
+ * Shown frames have their own seqlock, apart from lights_lock, so core 1 only
+ * copies the strip when a new frame was shown, into one of two static frames.
+ **/
+#define PIXELS_SHOW 0x01
+#define PIXELS_FILL 0x80
+
+_Static_assert(WS2812B_LED_SIZE <= 256, "Pixel runs address LEDs with a byte");
+
+typedef struct {
+  RGB_t rgb[WS2812B_LED_SIZE];
+  uint64_t timestamp;  // When the frame was shown, 0 never
+} pixels_frame_t;
+
+RGB_t pixels_staging[WS2812B_LED_SIZE];
+seqlock_t pixels_lock;
+pixels_frame_t pixels_shared;  // Written by core 0 under pixels_lock
+pixels_frame_t pixels_copies[2];
+pixels_frame_t* pixels_frame = &pixels_copies[0];  // Core 1's current frame
+uint32_t pixels_seq;  // pixels_lock sequence of pixels_frame
+
+/**
+ * Applies the runs of a REPORT_ID_PIXELS report to pixels_staging
+ * @param buffer Report data without the report ID
+ * @param len Length of buffer
+ * @return true if the staged frame should be shown
+ **/
+bool pixels_apply(uint8_t const* buffer, uint16_t len) {
+  if (len < 1) return false;
+  uint16_t pos = 1;
+  while (pos + 2 <= len) {
+    uint8_t start = buffer[pos];
+    uint8_t n = buffer[pos + 1];
+    uint8_t count = n & ~PIXELS_FILL;
+    bool fill = n & PIXELS_FILL;
+    pos += 2;
+    if (count == 0 || pos + (fill ? 3 : 3 * count) > len) break;
+    for (int i = 0; i < count && start + i < WS2812B_LED_SIZE; i++) {
+      const uint8_t* c = &buffer[pos + (fill ? 0 : 3 * i)];
+      pixels_staging[start + i] = (RGB_t){c[0], c[1], c[2]};
+    }
+    pos += fill ? 3 : 3 * count;
+  }
+  return buffer[0] & PIXELS_SHOW;
+}
+
+/**
+ * Hands the staged frame to core 1
+ **/
+void pixels_show() {
+  seqlock_write_begin(&pixels_lock);
+  memcpy(pixels_shared.rgb, pixels_staging, sizeof(pixels_shared.rgb));
+  pixels_shared.timestamp = time_us_64();
+  seqlock_write_end(&pixels_lock);
+}
+
+/**
+ * Points pixels_frame at the last shown frame, copying only if a new one was
+ * shown. A copy which overlapped a write is dropped and retried next time.
+ **/
+void pixels_fetch() {
+  uint32_t seq = pixels_lock.seq;
+  if (seq == pixels_seq) return;
+  pixels_frame_t* next =
+      &pixels_copies[pixels_frame == &pixels_copies[0] ? 1 : 0];
+  if (seqlock_read(&pixels_lock, next, &pixels_shared, sizeof(*next))) {
+    pixels_frame = next;
+    pixels_seq = seq;
+  }
+}
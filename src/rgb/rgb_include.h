@@ -5,8 +5,28 @@
  * To add a lighting mode, create a function which accepts a uint32_t as a parameter.
  * Create lighting mode as desired and then add the #include here.
  **/
-extern uint32_t enc_val[ENC_GPIO_SIZE];
-
 #include "ws2812b_util.c"
+#include "pixels.c"
+
+/**
+ * Everything core 1 needs from core 0. Core 0 publishes it under lights_lock
+ * and ws2812b_update copies it into lights_state at the start of every frame,
+ * so lighting modes should read lights_state instead of the core 0 globals.
+ * REPORT_ID_PIXELS frames go through pixels_lock instead, see pixels.c.
+ **/
+typedef struct {
+  RGB_t rgb[WS2812B_LED_ZONES];
+  uint64_t reactive_timeout_timestamp;
+  uint32_t enc_val[ENC_GPIO_SIZE];
+} lights_state_t;
+
+extern lights_state_t lights_state;
+
 #include "color_cycle.c"
-#include "turbocharger.c"
\ No newline at end of file
+#include "turbocharger.c"
+
+// Selectable by config.ws2812b_mode, only append so saved indices stay valid
+void (*const ws2812b_modes[])() = {
+    &ws2812b_color_cycle,
+    &turbocharger_color_cycle,
+};
\ No newline at end of file
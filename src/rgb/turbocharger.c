@@ -4,7 +4,7 @@
  * 
  * Move 2 lighting areas around the controller depending on knob input.
  * 
- * For each knob, calculate every 5 ms:
+ * For each knob, calculate every WS2812B_FRAME_US (5 ms):
  * - Add any knob delta to a counter
  * - Clamp counter to some "maximum speed"
  * - If counter is far enough from 0, knob is moving
@@ -29,82 +29,127 @@
  * Lighting areas start at position 0 and will light up the 3 nearest LEDs.
  * By strategically positioning led 0 at the top, this avoids lighting areas
  * from suddenly appeaering.
+ *
+ * When core 1 drops frames, the knob steps of every dropped frame still run
+ * before the one render, so the timing above holds at any strip length.
  **/
 
-#define TURBO_LIGHTS_CLAMP 0.1f
-#define TURBO_LIGHTS_THRESHOLD 0.05f
-#define TURBO_LIGHTS_DECAY 0.0005f
-#define TURBO_LIGHTS_VEL 0.12f
-#define TURBO_LIGHTS_MAX (WS2812B_LED_SIZE + 6.0f)
+/**
+ * All of the math is fixed point so core 1 never calls soft float. Knob
+ * counters are Q24 rotations, they stay within TURBO_LIGHTS_CLAMP. Light
+ * positions are Q16 LEDs, so they fit an int32_t up to 32K LEDs, and
+ * brightness is Q16 where TURBO_Q16(1.0f) is full brightness. The TURBO_Q
+ * macros are folded into integers at compile time.
+ **/
+#define TURBO_Q16(x) ((int32_t)((x) * 65536.0f + 0.5f))
+#define TURBO_Q24(x) ((int32_t)((x) * 16777216.0f + 0.5f))
+
+#define TURBO_LIGHTS_CLAMP TURBO_Q24(0.1f)
+#define TURBO_LIGHTS_THRESHOLD TURBO_Q24(0.05f)
+#define TURBO_LIGHTS_DECAY TURBO_Q24(0.0005f)
+#define TURBO_LIGHTS_VEL TURBO_Q16(0.12f)
+#define TURBO_LIGHTS_MAX TURBO_Q16(WS2812B_LED_SIZE + 6.0f)
 #define TURBO_LIGHTS_FADE 40
-#define TURBO_LIGHTS_FADE_VEL 0.025f
+#define TURBO_LIGHTS_FADE_VEL TURBO_Q16(0.025f)
+#define TURBO_ENC_STEP (TURBO_Q24(1.0f) / ENC_PULSE)
+#define TURBO_MAX_STEPS 40  // Catch up on at most 0.2 s of dropped frames
+
+// Positions run up to TURBO_LIGHTS_MAX plus one step, LEDs up to 2 past it
+_Static_assert(((int64_t)WS2812B_LED_SIZE + 8) << 16 <= INT32_MAX,
+               "Too many WS2812B LEDs for Q16 light positions");
 
 int i_clamp(int d, int min, int max) {
   const int t = d < min ? min : d;
   return t > max ? max : t;
 }
 
-float f_clamp(float d, float min, float max) {
-  const float t = d < min ? min : d;
-  return t > max ? max : t;
-}
-
-float f_one_mod(float d, float mod) {
-  const float t = d < 0 ? d + mod : d;
+int32_t q_one_mod(int32_t d, int32_t mod) {
+  const int32_t t = d < 0 ? d + mod : d;
   return t > mod ? t - mod : t;
 }
 
-float f_abs(float d) {
+int32_t q_abs(int32_t d) {
   return d < 0 ? -d : d;
 }
 
 uint32_t turbo_prev_enc_val[ENC_GPIO_SIZE];
-float turbo_cur_enc_val[ENC_GPIO_SIZE];
-float turbo_lights_pos[ENC_GPIO_SIZE];
-float turbo_lights_brightness[ENC_GPIO_SIZE];
+int32_t turbo_cur_enc_val[ENC_GPIO_SIZE];
+int32_t turbo_lights_pos[ENC_GPIO_SIZE];
+int32_t turbo_lights_brightness[ENC_GPIO_SIZE];
 int turbo_lights_idle[ENC_GPIO_SIZE];
+uint32_t turbo_prev_counter;
 
-void turbocharger_color_cycle(uint32_t unused) {
-  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
-    int enc_delta = (enc_val[i] - turbo_prev_enc_val[i]) * (ENC_REV[i] ? 1 : -1);
-    turbo_prev_enc_val[i] = enc_val[i];
-    turbo_cur_enc_val[i] = f_clamp(turbo_cur_enc_val[i] + (float)(enc_delta) / ENC_PULSE, -TURBO_LIGHTS_CLAMP, TURBO_LIGHTS_CLAMP);
-
-    if (turbo_cur_enc_val[i] < -TURBO_LIGHTS_THRESHOLD) {
-      turbo_lights_idle[i] = 0;
-      turbo_lights_pos[i] += TURBO_LIGHTS_VEL;
-      turbo_lights_brightness[i] = 1.0f;
-    } else if (turbo_cur_enc_val[i] > TURBO_LIGHTS_THRESHOLD) {
-      turbo_lights_idle[i] = 0;
-      turbo_lights_pos[i] -= TURBO_LIGHTS_VEL;
-      turbo_lights_brightness[i] = 1.0f;
+/**
+ * Strength of a lighting area at an LED, fading out over 2 LEDs
+ * @param area_pos Lighting area position, Q16
+ * @param led_pos LED position, Q16
+ * @param brightness Lighting area brightness, Q16
+ * @return Q16 strength
+ **/
+static inline int32_t turbo_strength(int32_t area_pos, int32_t led_pos,
+                                     int32_t brightness) {
+  int32_t d = i_clamp(q_abs(area_pos - led_pos), 0, TURBO_Q16(2.0f));
+  int32_t s = TURBO_Q16(1.0f) - d / 2;
+  // s * brightness >> 16 without overflowing 32 bits
+  return ((s * (brightness >> 8)) >> 8) + ((s * (brightness & 0xff)) >> 16);
+}
+
+/**
+ * Advances a knob's lighting area by one frame
+ * @param i Knob
+ * @param enc_delta Knob movement since the last step
+ **/
+void turbo_step(int i, int enc_delta) {
+  turbo_cur_enc_val[i] = i_clamp(turbo_cur_enc_val[i] + enc_delta * TURBO_ENC_STEP, -TURBO_LIGHTS_CLAMP, TURBO_LIGHTS_CLAMP);
+
+  if (turbo_cur_enc_val[i] < -TURBO_LIGHTS_THRESHOLD) {
+    turbo_lights_idle[i] = 0;
+    turbo_lights_pos[i] += TURBO_LIGHTS_VEL;
+    turbo_lights_brightness[i] = TURBO_Q16(1.0f);
+  } else if (turbo_cur_enc_val[i] > TURBO_LIGHTS_THRESHOLD) {
+    turbo_lights_idle[i] = 0;
+    turbo_lights_pos[i] -= TURBO_LIGHTS_VEL;
+    turbo_lights_brightness[i] = TURBO_Q16(1.0f);
+  } else {
+    turbo_lights_idle[i]++;
+    if (turbo_lights_idle[i] > TURBO_LIGHTS_FADE) {
+      turbo_lights_pos[i] = 0;
     } else {
-      turbo_lights_idle[i]++;
-      if (turbo_lights_idle[i] > TURBO_LIGHTS_FADE) {
-        turbo_lights_pos[i] = 0;
-      } else {
-        turbo_lights_brightness[i] = f_clamp(turbo_lights_brightness[i] - TURBO_LIGHTS_FADE_VEL, 0.0f, 1.0f);
-      }
+      turbo_lights_brightness[i] = i_clamp(turbo_lights_brightness[i] - TURBO_LIGHTS_FADE_VEL, 0, TURBO_Q16(1.0f));
     }
+  }
 
-    turbo_lights_pos[i] = f_one_mod(turbo_lights_pos[i], TURBO_LIGHTS_MAX);
+  turbo_lights_pos[i] = q_one_mod(turbo_lights_pos[i], TURBO_LIGHTS_MAX);
 
-    if (turbo_cur_enc_val[i] < -TURBO_LIGHTS_DECAY) {
-      turbo_cur_enc_val[i] += TURBO_LIGHTS_DECAY;
-    } else if (turbo_cur_enc_val[i] > TURBO_LIGHTS_DECAY) {
-      turbo_cur_enc_val[i] -= TURBO_LIGHTS_DECAY;
+  if (turbo_cur_enc_val[i] < -TURBO_LIGHTS_DECAY) {
+    turbo_cur_enc_val[i] += TURBO_LIGHTS_DECAY;
+  } else if (turbo_cur_enc_val[i] > TURBO_LIGHTS_DECAY) {
+    turbo_cur_enc_val[i] -= TURBO_LIGHTS_DECAY;
+  }
+}
+
+void turbocharger_color_cycle(uint32_t counter) {
+  uint32_t steps = counter - turbo_prev_counter;
+  if (steps > TURBO_MAX_STEPS) steps = TURBO_MAX_STEPS;
+  turbo_prev_counter = counter;
+
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    int enc_delta = (lights_state.enc_val[i] - turbo_prev_enc_val[i]) * (enc_rev(i) ? 1 : -1);
+    turbo_prev_enc_val[i] = lights_state.enc_val[i];
+    for (uint32_t s = 0; s < steps; s++) {
+      turbo_step(i, s == 0 ? enc_delta : 0);
     }
   }
 
   for (int i = 0; i < WS2812B_LED_SIZE; i++) {
-    float pos = 2.0f + i + (i >= WS2812B_LED_SIZE / 2 ? 3.0f : 0.0f);
-    float l_strength = (1.0f - f_clamp(f_abs(turbo_lights_pos[0] - pos), 0.0f, 2.0f) / 2) * turbo_lights_brightness[0];
-    float r_strength = (1.0f - f_clamp(f_abs(turbo_lights_pos[1] - pos), 0.0f, 2.0f) / 2) * turbo_lights_brightness[1];
+    int32_t pos = TURBO_Q16(2.0f) + (i << 16) + (i >= WS2812B_LED_SIZE / 2 ? TURBO_Q16(3.0f) : 0);
+    int32_t l_strength = turbo_strength(turbo_lights_pos[0], pos, turbo_lights_brightness[0]);
+    int32_t r_strength = turbo_strength(turbo_lights_pos[1], pos, turbo_lights_brightness[1]);
 
     put_pixel(urgb_u32(
-      i_clamp(l_strength * 70 + r_strength * 250, 0, 255),
-      i_clamp(l_strength * 230 + r_strength * 60, 0, 255),
-      i_clamp(l_strength * 250 + r_strength * 200, 0, 255)
+      i_clamp((l_strength * 70 + r_strength * 250) >> 16, 0, 255),
+      i_clamp((l_strength * 230 + r_strength * 60) >> 16, 0, 255),
+      i_clamp((l_strength * 250 + r_strength * 200) >> 16, 0, 255)
     ));
   }
 }
@@ -4,14 +4,44 @@
  */
 #include "ws2812.pio.h"
 
+#define WS2812B_BIT_NS 1250   // ws2812 programs run at 800 kHz
+#define WS2812B_RESET_US 280  // Latch gap, 50 us on older parts
+
 typedef struct {
   uint8_t r, g, b;
 } RGB_t;
 
+/**
+ * Gamma 2.2 brightness curve, used by urgb_u32 when WS2812B_GAMMA is set
+ **/
+static const uint8_t ws2812b_gamma[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6,
+    6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+    12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19,
+    20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28, 29,
+    30, 30, 31, 32, 33, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41,
+    42, 43, 43, 44, 45, 46, 47, 48, 49, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+    73, 74, 75, 76, 77, 78, 79, 81, 82, 83, 84, 85, 87, 88, 89, 90,
+    91, 93, 94, 95, 97, 98, 99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
 /**
  * WS2812B RGB Format Helper
  **/
 static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
+  if (WS2812B_GAMMA) {
+    r = ws2812b_gamma[r];
+    g = ws2812b_gamma[g];
+    b = ws2812b_gamma[b];
+  }
   return ((uint32_t)(r) << 8) | ((uint32_t)(g) << 16) | (uint32_t)(b);
 }
 
@@ -32,10 +62,138 @@ static inline uint32_t color_wheel(uint16_t wheel_pos) {
   }
 }
 
+/**
+ * Double buffered framebuffer. Lighting modes render into the back buffer with
+ * put_pixel while DMA streams the front buffer into the ws2812 state machine,
+ * so core 1 only spends render time on a frame, not wire time.
+ *
+ * With WS2812B_STRIPS > 1, LED i is LED i % WS2812B_LEDS_PER_STRIP of strip
+ * i / WS2812B_LEDS_PER_STRIP, and ws2812b_show transposes the frame into bit
+ * planes for the ws2812_parallel program: word n carries bit n % 24 of pixel
+ * n / 24 of every strip, strip s in bit s. All strips go out at once, so wire
+ * time only depends on WS2812B_LEDS_PER_STRIP.
+ **/
+_Static_assert(WS2812B_STRIPS >= 1 && WS2812B_STRIPS <= 32,
+               "ws2812_parallel drives 1 to 32 pins");
+_Static_assert(WS2812B_LED_SIZE % WS2812B_STRIPS == 0,
+               "Every strip needs the same number of LEDs");
+_Static_assert(WS2812B_GPIO + WS2812B_STRIPS <= NUM_BANK0_GPIOS,
+               "WS2812B strips run past the last GPIO");
+#ifdef RASPBERRYPI_PICO
+_Static_assert(WS2812B_GPIO + WS2812B_STRIPS <= 29,
+               "GPIO 29 only goes to the VSYS divider on a Pico");
+#endif
+
+uint32_t ws2812b_fb[2][WS2812B_LED_SIZE];
+#if WS2812B_STRIPS > 1
+uint32_t ws2812b_planes[2][WS2812B_LEDS_PER_STRIP * 24];
+#endif
+int ws2812b_fb_back;
+int ws2812b_fb_pos;
+int ws2812b_dma;
+uint64_t ws2812b_latch_time;  // When the strips will have latched the frame
+volatile uint32_t ws2812b_frames_dropped;  // Frames core 1 skipped, overruns
+
 /**
  * WS2812B RGB Assignment
  * @param pixel_grb The pixel color to set
  **/
 static inline void put_pixel(uint32_t pixel_grb) {
-  pio_sm_put_blocking(pio1, ENC_GPIO_SIZE, pixel_grb << 8u);
+  if (ws2812b_fb_pos < WS2812B_LED_SIZE) {
+    ws2812b_fb[ws2812b_fb_back][ws2812b_fb_pos++] = pixel_grb << 8u;
+  }
+}
+
+/**
+ * Transposes per strip pixels into ws2812_parallel bit planes
+ * @param fb Pixels as put_pixel stores them, GRB in the top 24 bits, strip
+ * after strip
+ * @param planes 24 words per pixel of a strip, MSB first, strip s in bit s
+ * @param strips Number of strips
+ * @param len Pixels per strip
+ **/
+void ws2812b_transpose(const uint32_t* fb, uint32_t* planes, int strips,
+                       int len) {
+  for (int p = 0; p < len; p++) {
+    uint32_t* out = &planes[p * 24];
+    for (int b = 0; b < 24; b++) out[b] = 0;
+    for (int s = 0; s < strips; s++) {
+      uint32_t pixel = fb[s * len + p];
+      for (int b = 0; b < 24 && pixel != 0; b++, pixel <<= 1) {
+        out[b] |= (pixel >> 31) << s;
+      }
+    }
+  }
+}
+
+/**
+ * Starts a frame once the last one is out and latched. The DMA finishes while
+ * its last words are still in the FIFO, so the end of the frame is worked out
+ * from its length instead: WS2812B_BIT_NS per bit, then the line has to stay
+ * low for WS2812B_RESET_US before the strip shows it.
+ * @param words Words for the ws2812 FIFO
+ * @param count Number of words
+ * @param pixels Pixels per strip
+ **/
+static inline void ws2812b_start(const uint32_t* words, uint32_t count,
+                                 uint32_t pixels) {
+  dma_channel_wait_for_finish_blocking(ws2812b_dma);
+  busy_wait_until(from_us_since_boot(ws2812b_latch_time));
+  dma_channel_transfer_from_buffer_now(ws2812b_dma, words, count);
+  ws2812b_latch_time = time_us_64() +
+                       (pixels * 24 * WS2812B_BIT_NS + 999) / 1000 +
+                       WS2812B_RESET_US;
+}
+
+/**
+ * Send the rendered frame and start rendering into the other buffer
+ **/
+void ws2812b_show() {
+#if WS2812B_STRIPS > 1
+  // Transpose before waiting, the other planes buffer may still be on the wire
+  uint32_t* planes = ws2812b_planes[ws2812b_fb_back];
+  ws2812b_transpose(ws2812b_fb[ws2812b_fb_back], planes, WS2812B_STRIPS,
+                    WS2812B_LEDS_PER_STRIP);
+  ws2812b_start(planes, WS2812B_LEDS_PER_STRIP * 24, WS2812B_LEDS_PER_STRIP);
+#else
+  ws2812b_start(ws2812b_fb[ws2812b_fb_back], ws2812b_fb_pos, ws2812b_fb_pos);
+#endif
+  ws2812b_fb_back ^= 1;
+  ws2812b_fb_pos = 0;
+}
+
+/**
+ * @param pin GPIO
+ * @return true if a switch, switch LED or encoder is on pin
+ **/
+bool ws2812b_pin_taken(uint pin) {
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if (SW_GPIO[i] == pin) return true;
+  }
+  for (int i = 0; i < LED_GPIO_SIZE; i++) {
+    if (LED_GPIO[i] == pin) return true;
+  }
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    if (ENC_GPIO[i] == pin || ENC_GPIO[i] + 1 == pin) return true;
+  }
+  return false;
+}
+
+/**
+ * Set up the framebuffer DMA channel
+ * @param pio PIO running the ws2812 program
+ * @param sm State machine running the ws2812 program
+ **/
+void ws2812b_init(PIO pio, uint sm) {
+  ws2812b_dma = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(ws2812b_dma);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+  dma_channel_configure(ws2812b_dma, &c,
+                        &pio->txf[sm],  // Destination pointer
+                        NULL,           // Source pointer, set per frame
+                        0,              // Number of transfers, set per frame
+                        false           // Don't start yet
+  );
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+ * Log2 timing histograms
+ * @author SpeedyPotato
+ *
+ * Each metric counts samples into 24 buckets, bucket b holding samples in
+ * [2^b, 2^(b+1)), with the last bucket also taking anything larger. Cycle
+ * metrics are timed with SysTick, a free running 24 bit down counter at
+ * clk_sys which every core has its own copy of, so a sample costs two register
+ * reads. Spans past 2^24 cycles (134 ms at 125 MHz) wrap, so slow intervals
+ * are timed in us instead.
+ *
+ * A bucket that fills up halves every bucket of its metric, so long uptimes
+ * keep the shape of the distribution rather than clipping. count and max are
+ * since the last reset. Every metric has one writer, the core which times it,
+ * and goes through a seqlock so the other core can read it. Resets are only
+ * requested, the writer clears the metric on its next sample.
+ *
+ * Feature report REPORT_ID_STATS reads them back without a debugger. SET with
+ * byte 0 = metric selects what GET returns, bit 7 set also resets it. GET
+ * returns 63 bytes, multi byte fields little endian:
+ *   0      metric
+ *   1      unit, HIST_UNIT_*
+ *   2      number of buckets
+ *   3-6    clk_sys in Hz
+ *   7-10   count
+ *   11-14  max
+ *   15-62  uint16 buckets
+ **/
+
+#define HIST_BUCKETS 24
+#define HIST_REPORT_SIZE (15 + HIST_BUCKETS * 2)
+_Static_assert(HIST_REPORT_SIZE == STATS_REPORT_SIZE,
+               "Stats report doesn't match its descriptor");
+_Static_assert(HIST_REPORT_SIZE < CFG_TUD_HID_EP_BUFSIZE,
+               "Stats report and report ID must fit the HID endpoint buffer");
+
+enum {
+  HIST_LOOP,       // Input pass start to start, cycles
+  HIST_DEBOUNCE,   // Switch sampling and debounce, cycles
+  HIST_TUD_TASK,   // tud_task(), cycles
+  HIST_RENDER,     // Core 1 WS2812B frame, cycles
+  HIST_REPORT,     // Input report to input report, us
+  HIST_COUNT,
+};
+
+enum {
+  HIST_UNIT_CYCLES,
+  HIST_UNIT_US,
+};
+
+typedef struct {
+  uint32_t count;                 // Samples since reset
+  uint32_t max;                   // Largest sample since reset
+  uint16_t bucket[HIST_BUCKETS];  // Samples per log2 bucket
+} hist_t;
+
+typedef struct {
+  seqlock_t lock;
+  hist_t hist;
+  uint32_t last;        // Previous lap or interval start, 0 before the first
+  volatile bool reset;  // Clear on the next sample
+} hist_metric_t;
+
+hist_metric_t hist_metrics[HIST_COUNT];
+uint8_t hist_selected;  // Metric returned by the feature report
+
+/**
+ * Starts SysTick on the calling core, each core needs its own call
+ **/
+void hist_init() {
+  if (!LATENCY_STATS) return;
+  systick_hw->rvr = 0x00ffffff;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;  // Enable, clocked by the processor
+}
+
+/**
+ * @return Current SysTick count, counting down
+ **/
+static inline uint32_t hist_cycles() { return systick_hw->cvr; }
+
+/**
+ * Adds a sample to a metric
+ * @param metric HIST_* metric
+ * @param value Sample in the metric's unit
+ **/
+void hist_add(int metric, uint32_t value) {
+  hist_metric_t* m = &hist_metrics[metric];
+  int b = value ? 31 - __builtin_clz(value) : 0;
+  if (b >= HIST_BUCKETS) b = HIST_BUCKETS - 1;
+
+  seqlock_write_begin(&m->lock);
+  if (m->reset) {
+    memset(&m->hist, 0, sizeof(m->hist));
+    m->reset = false;
+  }
+  if (m->hist.bucket[b] == UINT16_MAX) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+      m->hist.bucket[i] >>= 1;
+    }
+  }
+  m->hist.bucket[b]++;
+  m->hist.count++;
+  if (value > m->hist.max) m->hist.max = value;
+  seqlock_write_end(&m->lock);
+}
+
+/**
+ * Adds the cycles since start to a metric
+ * @param metric HIST_* metric
+ * @param start hist_cycles() at the start of the span
+ **/
+static inline void hist_span(int metric, uint32_t start) {
+  if (!LATENCY_STATS) return;
+  hist_add(metric, (start - hist_cycles()) & 0x00ffffff);
+}
+
+/**
+ * Adds the cycles since the previous lap to a metric, the first lap only
+ * starts timing
+ * @param metric HIST_* metric
+ * @return hist_cycles() at this lap
+ **/
+static inline uint32_t hist_lap(int metric) {
+  uint32_t now = hist_cycles();
+  if (!LATENCY_STATS) return now;
+  hist_metric_t* m = &hist_metrics[metric];
+  if (m->last != 0) hist_add(metric, (m->last - now) & 0x00ffffff);
+  m->last = now | 0x01000000;  // Never 0 once started
+  return now;
+}
+
+/**
+ * Adds the time since the previous call to a metric, the first call only
+ * starts the interval
+ * @param metric HIST_* metric
+ * @param now Current time in the metric's unit, counting up
+ **/
+static inline void hist_interval(int metric, uint32_t now) {
+  if (!LATENCY_STATS) return;
+  hist_metric_t* m = &hist_metrics[metric];
+  if (m->last != 0) hist_add(metric, now - m->last);
+  m->last = now ? now : 1;
+}
+
+/**
+ * Copies a metric out, safe from either core
+ * @param metric HIST_* metric
+ * @param dst Where to copy to
+ * @return false if the writer kept overlapping the copy
+ **/
+bool hist_read(int metric, hist_t* dst) {
+  for (int tries = 0; tries < 4; tries++) {
+    if (seqlock_read(&hist_metrics[metric].lock, dst,
+                     &hist_metrics[metric].hist, sizeof(*dst))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * SET_REPORT for REPORT_ID_STATS, selects and optionally resets a metric
+ * @param buffer Report data without the report ID
+ * @param len Length of buffer
+ **/
+void hist_set_report(uint8_t const* buffer, uint16_t len) {
+  if (len < 1 || (buffer[0] & 0x7f) >= HIST_COUNT) return;
+  hist_selected = buffer[0] & 0x7f;
+  if (buffer[0] & 0x80) hist_metrics[hist_selected].reset = true;
+}
+
+/**
+ * GET_REPORT for REPORT_ID_STATS
+ * @param buffer Report data without the report ID
+ * @param reqlen Space in buffer
+ * @return Length of the report, 0 to stall
+ **/
+uint16_t hist_get_report(uint8_t* buffer, uint16_t reqlen) {
+  static const uint8_t units[HIST_COUNT] = {
+      HIST_UNIT_CYCLES, HIST_UNIT_CYCLES, HIST_UNIT_CYCLES,
+      HIST_UNIT_CYCLES, HIST_UNIT_US,
+  };
+  hist_t h;
+  if (reqlen < HIST_REPORT_SIZE || !hist_read(hist_selected, &h)) return 0;
+
+  uint32_t hz = clock_get_hz(clk_sys);
+  buffer[0] = hist_selected;
+  buffer[1] = units[hist_selected];
+  buffer[2] = HIST_BUCKETS;
+  memcpy(&buffer[3], &hz, 4);
+  memcpy(&buffer[7], &h.count, 4);
+  memcpy(&buffer[11], &h.max, 4);
+  memcpy(&buffer[15], h.bucket, sizeof(h.bucket));
+  return HIST_REPORT_SIZE;
+}
@@ -0,0 +1,217 @@
+/**
+ * Hot path latency counters
+ * @author SpeedyPotato
+ *
+ * - Switch edge to report latency: time from the first loop which sees the
+ *   raw switch state differ from the last reported buttons, to the
+ *   tud_hid_n_report call which carries the new buttons.
+ * - Input passes per millisecond, over 1 ms windows.
+ * - Reports per second delivered to the host on each HID interface.
+ * - With USB_SCHED_PERIOD_US, how late the timer ran the input pass.
+ * - Encoder DMA restart IRQs per second, 0 once every encoder is chained.
+ * - WS2812B frames dropped per second because a frame overran
+ *   WS2812B_FRAME_US.
+ * - With USB_SOF_SYNC, how long before the SOF reports were built, negative
+ *   if they were built after it.
+ *
+ * Feature report REPORT_ID_LATENCY reads them back. SET with byte 0 = page
+ * selects what GET returns, bit 7 set also clears the page's worst cases and
+ * totals. GET returns LATENCY_REPORT_SIZE bytes, 32 bit little endian fields
+ * after byte 0:
+ *   0      page
+ *   LATENCY_PAGE_STATS, from byte 1: latency_stats_t in field order
+ *   LATENCY_PAGE_SCHED, from byte 1: sent, suppressed for each report
+ *   scheduler, gamepad then keyboard then mouse
+ * The counters are only written by the input pass, which also answers the
+ * control requests, so the report copies them without a lock.
+ **/
+
+typedef struct {
+  uint32_t latency_last_us;  // Most recent edge to report latency
+  uint32_t latency_max_us;   // Worst edge to report latency since boot
+  uint32_t latency_count;    // Number of measured edges
+  uint32_t loops_per_ms;     // Main loop iterations in the last 1 ms window
+  uint32_t loops_per_ms_min; // Slowest 1 ms window since boot
+  uint32_t reports_per_s[CFG_TUD_HID];  // Reports delivered per interface
+  uint32_t sched_late_max_us;  // Worst scheduled input pass lateness
+  uint32_t enc_irqs_per_s;     // Encoder DMA restarts by dma_handler
+  uint32_t lights_dropped_per_s;  // WS2812B frames skipped by core 1
+  int32_t sof_offset_us;          // Last report build to SOF
+  int32_t sof_offset_max_us;      // Oldest inputs a SOF found
+} latency_stats_t;
+
+_Static_assert(1 + sizeof(latency_stats_t) <= LATENCY_REPORT_SIZE,
+               "Latency stats don't fit their feature report");
+
+enum {
+  LATENCY_PAGE_STATS,
+  LATENCY_PAGE_SCHED,
+  LATENCY_PAGE_COUNT,
+};
+
+latency_stats_t latency_stats = {.loops_per_ms_min = UINT32_MAX};
+uint8_t latency_page;  // Page returned by the feature report
+
+uint64_t stats_edge_timestamp;  // 0 when no edge is waiting for a report
+uint16_t stats_reported_buttons;
+uint64_t stats_window_timestamp;
+uint32_t stats_window_loops;
+uint64_t stats_rate_timestamp;
+uint32_t stats_report_count[CFG_TUD_HID];
+uint32_t stats_enc_irqs;  // enc_dma_irqs at the start of the window
+uint32_t stats_lights_dropped;  // ws2812b_frames_dropped at the start
+uint64_t stats_sched_timestamp;  // When the next scheduled pass is due
+
+/**
+ * Count a main loop iteration
+ * @param now Current time in us
+ **/
+static inline void stats_loop(uint64_t now) {
+  if (!LATENCY_STATS) return;
+  stats_window_loops++;
+  if (now - stats_window_timestamp >= 1000) {
+    latency_stats.loops_per_ms = stats_window_loops;
+    if (stats_window_timestamp != 0 &&
+        stats_window_loops < latency_stats.loops_per_ms_min) {
+      latency_stats.loops_per_ms_min = stats_window_loops;
+    }
+    stats_window_loops = 0;
+    stats_window_timestamp = now;
+  }
+  if (now - stats_rate_timestamp >= 1000000) {
+    for (int i = 0; i < CFG_TUD_HID; i++) {
+      latency_stats.reports_per_s[i] = stats_report_count[i];
+      stats_report_count[i] = 0;
+    }
+    uint32_t irqs = enc_dma_irqs;
+    latency_stats.enc_irqs_per_s = irqs - stats_enc_irqs;
+    stats_enc_irqs = irqs;
+    uint32_t dropped = ws2812b_frames_dropped;
+    latency_stats.lights_dropped_per_s = dropped - stats_lights_dropped;
+    stats_lights_dropped = dropped;
+    stats_rate_timestamp = now;
+  }
+}
+
+/**
+ * Track raw switch state against what was last reported
+ * @param raw Raw switch bitmask, 1 = pressed
+ * @param now Current time in us
+ **/
+static inline void stats_input(uint16_t raw, uint64_t now) {
+  if (!LATENCY_STATS) return;
+  if (raw == stats_reported_buttons) {
+    stats_edge_timestamp = 0;  // Bounced back before it was reported
+  } else if (stats_edge_timestamp == 0) {
+    stats_edge_timestamp = now;
+  }
+}
+
+/**
+ * Record that a report carrying buttons was handed to TinyUSB
+ * @param buttons Button bitmask in the report
+ * @param now Current time in us
+ **/
+static inline void stats_report(uint16_t buttons, uint64_t now) {
+  if (!LATENCY_STATS) return;
+  if (buttons == stats_reported_buttons) return;
+  stats_reported_buttons = buttons;
+  if (stats_edge_timestamp != 0) {
+    uint32_t latency = now - stats_edge_timestamp;
+    latency_stats.latency_last_us = latency;
+    if (latency > latency_stats.latency_max_us) {
+      latency_stats.latency_max_us = latency;
+    }
+    latency_stats.latency_count++;
+    stats_edge_timestamp = 0;
+  }
+}
+
+/**
+ * Count a report delivered to the host
+ * @param instance HID instance the report went out on
+ **/
+static inline void stats_report_complete(uint8_t instance) {
+  if (!LATENCY_STATS) return;
+  if (instance < CFG_TUD_HID) stats_report_count[instance]++;
+}
+
+/**
+ * Track how late a scheduled input pass started
+ * @param now Time the pass started in us
+ * @param period_us Schedule period in us
+ **/
+static inline void stats_sched(uint64_t now, uint32_t period_us) {
+  if (!LATENCY_STATS) return;
+  if (stats_sched_timestamp != 0 && now > stats_sched_timestamp) {
+    uint32_t late = now - stats_sched_timestamp;
+    if (late > latency_stats.sched_late_max_us) {
+      latency_stats.sched_late_max_us = late;
+    }
+  }
+  stats_sched_timestamp =
+      (stats_sched_timestamp == 0 ? now : stats_sched_timestamp) + period_us;
+}
+
+/**
+ * Track how long before the SOF reports were built
+ * @param offset_us Report build to SOF in us, SOF_NO_SAMPLE if there was none
+ **/
+static inline void stats_sof(int32_t offset_us) {
+  if (!LATENCY_STATS || offset_us == SOF_NO_SAMPLE) return;
+  latency_stats.sof_offset_us = offset_us;
+  if (offset_us > latency_stats.sof_offset_max_us) {
+    latency_stats.sof_offset_max_us = offset_us;
+  }
+}
+
+/**
+ * SET_REPORT for REPORT_ID_LATENCY, selects and optionally resets a page
+ * @param buffer Report data without the report ID
+ * @param len Length of buffer
+ * @param scheds Report schedulers for LATENCY_PAGE_SCHED
+ * @param nscheds Number of schedulers
+ **/
+void latency_set_report(uint8_t const* buffer, uint16_t len,
+                        report_sched_t* const* scheds, int nscheds) {
+  if (len < 1 || (buffer[0] & 0x7f) >= LATENCY_PAGE_COUNT) return;
+  latency_page = buffer[0] & 0x7f;
+  if (!(buffer[0] & 0x80)) return;
+
+  if (latency_page == LATENCY_PAGE_STATS) {
+    latency_stats.latency_max_us = 0;
+    latency_stats.latency_count = 0;
+    latency_stats.loops_per_ms_min = UINT32_MAX;
+    latency_stats.sched_late_max_us = 0;
+    latency_stats.sof_offset_max_us = 0;
+  } else {
+    for (int i = 0; i < nscheds; i++) {
+      scheds[i]->sent = 0;
+      scheds[i]->suppressed = 0;
+    }
+  }
+}
+
+/**
+ * GET_REPORT for REPORT_ID_LATENCY
+ * @param buffer Report data without the report ID
+ * @param reqlen Space in buffer
+ * @param scheds Report schedulers for LATENCY_PAGE_SCHED
+ * @param nscheds Number of schedulers
+ * @return Length of the report, 0 to stall
+ **/
+uint16_t latency_get_report(uint8_t* buffer, uint16_t reqlen,
+                            report_sched_t* const* scheds, int nscheds) {
+  if (reqlen < LATENCY_REPORT_SIZE) return 0;
+  memset(buffer, 0, LATENCY_REPORT_SIZE);
+  buffer[0] = latency_page;
+  if (latency_page == LATENCY_PAGE_STATS) {
+    memcpy(&buffer[1], &latency_stats, sizeof(latency_stats));
+  } else {
+    for (int i = 0; i < nscheds && 9 + i * 8 <= LATENCY_REPORT_SIZE; i++) {
+      memcpy(&buffer[1 + i * 8], &scheds[i]->sent, 4);
+      memcpy(&buffer[5 + i * 8], &scheds[i]->suppressed, 4);
+    }
+  }
+  return LATENCY_REPORT_SIZE;
+}
@@ -0,0 +1,10 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Stats are cheap counters updated from the input pass so hot path changes can
+ * be measured on real hardware. Counters only run when LATENCY_STATS is set in
+ * controller_config.h; the functions compile to nothing otherwise.
+ **/
+#include "histogram.c"
+#include "latency.c"
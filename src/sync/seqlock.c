@@ -0,0 +1,42 @@
+/**
+ * Single writer sequence lock
+ * @author SpeedyPotato
+ *
+ * The writer bumps seq to odd, updates the shared data, then bumps seq back to
+ * even. A reader copies the data out and only keeps the copy if seq was even
+ * and unchanged around the copy, otherwise it retries or keeps its previous
+ * copy. The writer never waits, and a reader never waits on a lock either, so
+ * neither core can stall the other. Only one core may write a given lock.
+ **/
+
+typedef struct {
+  volatile uint32_t seq;
+} seqlock_t;
+
+static inline void seqlock_write_begin(seqlock_t* l) {
+  l->seq++;
+  __dmb();
+}
+
+static inline void seqlock_write_end(seqlock_t* l) {
+  __dmb();
+  l->seq++;
+}
+
+/**
+ * Copies the shared data out of a seqlock
+ * @param l Lock guarding src
+ * @param dst Where to copy to
+ * @param src Shared data
+ * @param len Bytes to copy
+ * @return false if a write overlapped the copy and dst may be torn
+ **/
+static inline bool seqlock_read(seqlock_t* l, void* dst, const void* src,
+                                size_t len) {
+  uint32_t seq = l->seq;
+  if (seq & 1) return false;
+  __dmb();
+  memcpy(dst, src, len);
+  __dmb();
+  return l->seq == seq;
+}
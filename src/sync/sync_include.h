@@ -0,0 +1,8 @@
+/**
+ * Simple header file to include all files in the folder
+ * @author SpeedyPotato
+ *
+ * Helpers for sharing state between core 0 and core 1 without either core
+ * ever waiting on the other.
+ **/
+#include "seqlock.c"
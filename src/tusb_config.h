@@ -96,7 +96,7 @@ extern "C" {
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_HID 1
+#define CFG_TUD_HID 2  // Keyboard mode uses a second interface for the mouse
 #define CFG_TUD_CDC 0
 #define CFG_TUD_MSC 0
 #define CFG_TUD_MIDI 0
@@ -33,11 +33,18 @@
  *
  * Auto ProductID layout's Bitmap:
  *   [MSB]         HID | MSC | CDC          [LSB]
+ *
+ * bcdDevice goes up when the descriptors change without the interfaces
+ * changing, like the HID interrupt OUT endpoint, so hosts which cached the
+ * older descriptors read them again.
  */
 #define _PID_MAP(itf, n) ((CFG_TUD_##itf) << (n))
-#define USB_PID                                                      \
-  (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
-   _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4))
+#define USB_PID                                                   \
+  (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) |                 \
+   ((CFG_TUD_HID ? 1 : 0) << 2) | _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4))
+// Keyboard mode has a second HID interface, so it needs its own product id
+#define USB_PID_KEY (USB_PID | 0x0020)
+#define USB_BCD_DEVICE 0x0101
 
 //--------------------------------------------------------------------+
 // Device Descriptors
@@ -53,7 +60,7 @@ tusb_desc_device_t const desc_device_joy = {
 
     .idVendor = 0xCafe,
     .idProduct = USB_PID,
-    .bcdDevice = 0x0100,
+    .bcdDevice = USB_BCD_DEVICE,
 
     .iManufacturer = 0x01,
     .iProduct = 0x02,
@@ -71,8 +78,8 @@ tusb_desc_device_t const desc_device_key = {
     .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
 
     .idVendor = 0xCafe,
-    .idProduct = USB_PID,
-    .bcdDevice = 0x0100,
+    .idProduct = USB_PID_KEY,
+    .bcdDevice = USB_BCD_DEVICE,
 
     .iManufacturer = 0x01,
     .iProduct = 0x02,
@@ -92,12 +99,35 @@ uint8_t const* tud_descriptor_device_cb(void) {
 
 uint8_t const desc_hid_report_joy[] = {
     GAMECON_REPORT_DESC_JOYSTICK(HID_REPORT_ID(REPORT_ID_JOYSTICK)),
-    GAMECON_REPORT_DESC_LIGHTS(HID_REPORT_ID(REPORT_ID_LIGHTS))
+    GAMECON_REPORT_DESC_LIGHTS(HID_REPORT_ID(REPORT_ID_LIGHTS)),
+    GAMECON_REPORT_DESC_FEATURE(0x01, STATS_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_STATS)),
+    GAMECON_REPORT_DESC_FEATURE(0x02, CONFIG_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_CONFIG)),
+    GAMECON_REPORT_DESC_FEATURE(0x03, DEBOUNCE_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_DEBOUNCE)),
+    GAMECON_REPORT_DESC_OUTPUT(0x04, PIXELS_REPORT_SIZE,
+                               HID_REPORT_ID(REPORT_ID_PIXELS)),
+    GAMECON_REPORT_DESC_FEATURE(0x05, LATENCY_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_LATENCY))
 };
 
 uint8_t const desc_hid_report_key[] = {
     GAMECON_REPORT_DESC_LIGHTS(HID_REPORT_ID(REPORT_ID_LIGHTS)),
     GAMECON_REPORT_DESC_NKRO(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+    GAMECON_REPORT_DESC_FEATURE(0x01, STATS_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_STATS)),
+    GAMECON_REPORT_DESC_FEATURE(0x02, CONFIG_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_CONFIG)),
+    GAMECON_REPORT_DESC_FEATURE(0x03, DEBOUNCE_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_DEBOUNCE)),
+    GAMECON_REPORT_DESC_OUTPUT(0x04, PIXELS_REPORT_SIZE,
+                               HID_REPORT_ID(REPORT_ID_PIXELS)),
+    GAMECON_REPORT_DESC_FEATURE(0x05, LATENCY_REPORT_SIZE,
+                                HID_REPORT_ID(REPORT_ID_LATENCY))
+};
+
+uint8_t const desc_hid_report_mouse[] = {
     TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE))
 };
 
@@ -105,43 +135,51 @@ uint8_t const desc_hid_report_key[] = {
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const* tud_hid_descriptor_report_cb(uint8_t itf) {
-  (void)itf;
-  return (joy_mode_check ? desc_hid_report_joy : desc_hid_report_key);
+  if (joy_mode_check) return desc_hid_report_joy;
+  return (itf == ITF_NUM_HID_MOUSE ? desc_hid_report_mouse
+                                   : desc_hid_report_key);
 }
 
 //--------------------------------------------------------------------+
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
-enum { ITF_NUM_HID, ITF_NUM_TOTAL };
-
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define CONFIG_TOTAL_LEN_KEY \
+  (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_HID_DESC_LEN)
 
+// Output reports can also come in on EPNUM_HID_OUT, so lighting doesn't have
+// to share control transfers with everything else
 #define EPNUM_HID 0x81
+#define EPNUM_HID_OUT 0x01
+#define EPNUM_HID_MOUSE 0x82
 
 uint8_t const desc_configuration_joy[] = {
     // Config number, interface count, string index, total length, attribute,
     // power in mA
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN,
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_HID + 1, 0, CONFIG_TOTAL_LEN,
                           TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
-    // Interface number, string index, protocol, report descriptor len, EP In
-    // address, size & polling interval
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE,
-                       sizeof(desc_hid_report_joy), EPNUM_HID,
-                       CFG_TUD_HID_EP_BUFSIZE, 1)};
+    // Interface number, string index, protocol, report descriptor len, EP Out
+    // & In address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE,
+                             sizeof(desc_hid_report_joy), EPNUM_HID_OUT,
+                             EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 1)};
 
 
 uint8_t const desc_configuration_key[] = {
     // Config number, interface count, string index, total length, attribute,
     // power in mA
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN,
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL_KEY, 0, CONFIG_TOTAL_LEN_KEY,
                           TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
-    // Interface number, string index, protocol, report descriptor len, EP In
-    // address, size & polling interval
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE,
-                       sizeof(desc_hid_report_key), EPNUM_HID,
+    // Interface number, string index, protocol, report descriptor len, EP Out
+    // & In address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE,
+                             sizeof(desc_hid_report_key), EPNUM_HID_OUT,
+                             EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 1),
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID_MOUSE, 0, HID_ITF_PROTOCOL_NONE,
+                       sizeof(desc_hid_report_mouse), EPNUM_HID_MOUSE,
                        CFG_TUD_HID_EP_BUFSIZE, 1)};
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
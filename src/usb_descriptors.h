@@ -10,6 +10,20 @@ enum {
   REPORT_ID_LIGHTS,
   REPORT_ID_KEYBOARD,
   REPORT_ID_MOUSE,
+  REPORT_ID_STATS,
+  REPORT_ID_CONFIG,
+  REPORT_ID_DEBOUNCE,
+  REPORT_ID_PIXELS,
+  REPORT_ID_LATENCY,
+};
+
+// Gamepad mode only uses ITF_NUM_HID. Keyboard mode puts the mouse on its own
+// interface and endpoint so keyboard and mouse reports both go out every
+// frame. HID instance numbers follow the interface numbers.
+enum {
+  ITF_NUM_HID,
+  ITF_NUM_HID_MOUSE,
+  ITF_NUM_TOTAL_KEY,
 };
 
 // because they are missing from tusb_hid.h
@@ -21,7 +35,7 @@ enum {
 #define HID_STRING_MAXIMUM_N(x, n) HID_REPORT_ITEM(x, 9, RI_TYPE_LOCAL, n)
 
 // Joystick Report Descriptor Template - Based off Drewol/rp2040-gamecon
-// Button Map | X | Y
+// Button Map | X | Y | ..., one JOY_AXIS_BITS wide axis per encoder from X
 #define GAMECON_REPORT_DESC_JOYSTICK(...)                                      \
   HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),                                      \
       HID_USAGE(HID_USAGE_DESKTOP_JOYSTICK),                                   \
@@ -33,9 +47,11 @@ enum {
       HID_REPORT_COUNT(1), HID_REPORT_SIZE(16 - SW_GPIO_SIZE), /*Padding*/\
       HID_INPUT(HID_CONSTANT | HID_VARIABLE | HID_ABSOLUTE),                   \
       HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP), HID_LOGICAL_MIN(0x00),           \
-      HID_LOGICAL_MAX_N(0x00ff, 2),                                            \
-      HID_USAGE(HID_USAGE_DESKTOP_X), /*Joystick*/                             \
-      HID_USAGE(HID_USAGE_DESKTOP_Y), HID_REPORT_COUNT(2), HID_REPORT_SIZE(8), \
+      HID_LOGICAL_MAX_N(JOY_AXIS_MAX, 3),                                      \
+      HID_USAGE_MIN(HID_USAGE_DESKTOP_X), /*Joystick*/                         \
+      HID_USAGE_MAX(HID_USAGE_DESKTOP_X + ENC_GPIO_SIZE - 1),                  \
+      HID_REPORT_COUNT(ENC_GPIO_SIZE),                                         \
+      HID_REPORT_SIZE(JOY_AXIS_BITS),                                          \
       HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_COLLECTION_END
 
 // Light Map
@@ -63,4 +79,28 @@ enum {
       HID_USAGE_PAGE(HID_USAGE_PAGE_KEYBOARD), HID_USAGE_MIN(0),              \
       HID_USAGE_MAX(31 * 8 - 1), HID_INPUT(HID_VARIABLE), HID_COLLECTION_END
 
+// Vendor Feature Report - size bytes for tools to read and write, not the OS
+#define GAMECON_REPORT_DESC_FEATURE(usage, size, ...)                         \
+  HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2), HID_USAGE(usage),               \
+      HID_COLLECTION(HID_COLLECTION_APPLICATION),                             \
+      __VA_ARGS__ HID_USAGE(usage), HID_LOGICAL_MIN(0x00),                    \
+      HID_LOGICAL_MAX_N(0x00ff, 2), HID_REPORT_SIZE(8),                       \
+      HID_REPORT_COUNT(size),                                                 \
+      HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_COLLECTION_END
+
+// Vendor Output Report - size bytes for tools to write, not the OS
+#define GAMECON_REPORT_DESC_OUTPUT(usage, size, ...)                          \
+  HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2), HID_USAGE(usage),               \
+      HID_COLLECTION(HID_COLLECTION_APPLICATION),                             \
+      __VA_ARGS__ HID_USAGE(usage), HID_LOGICAL_MIN(0x00),                    \
+      HID_LOGICAL_MAX_N(0x00ff, 2), HID_REPORT_SIZE(8),                       \
+      HID_REPORT_COUNT(size),                                                 \
+      HID_OUTPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_COLLECTION_END
+
+#define STATS_REPORT_SIZE 63                    // See stats/histogram.c
+#define CONFIG_REPORT_SIZE (13 + SW_GPIO_SIZE)  // See config/runtime_config.c
+#define DEBOUNCE_REPORT_SIZE 58                 // See debounce/metrics.c
+#define PIXELS_REPORT_SIZE 63                   // See rgb/pixels.c
+#define LATENCY_REPORT_SIZE 49                  // See stats/latency.c
+
 #endif /* USB_DESCRIPTORS_H_ */
\ No newline at end of file
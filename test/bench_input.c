@@ -0,0 +1,223 @@
+/**
+ * Input pass benchmark: switch edge to tud_hid_n_report latency and input
+ * passes per ms, in gamepad or keyboard mode
+ * @author SpeedyPotato
+ *
+ * Usage: bench_input joy|key [seconds]
+ *
+ * Latency runs on simulated time. Every pass takes BENCH_PASS_US, a switch
+ * flips every 200 to 1500 us, each at most once per debounce window, and the
+ * fake USB stack takes one report per interface per 1 ms frame, so edges
+ * often have to wait for the endpoint. The numbers are the same on every
+ * machine, and the run fails if an edge waits longer than the next free
+ * frame.
+ *
+ * With the switches left alone, every report scheduler in use then has to
+ * count each 1 ms frame as sent or suppressed, and suppress at most once per
+ * frame however many passes run in it. Then a switch flips every frame while
+ * the knobs spin, and every interface in use has to report about every frame.
+ *
+ * Throughput then runs the same loop against the host clock for
+ * BENCH_REAL_MS. It depends on the machine so it is only printed, for
+ * comparing a change against its parent on the same runner.
+ **/
+#include "test.h"
+
+#define BENCH_PASS_US 20
+#define BENCH_REAL_MS 200
+#define BENCH_LATENCY_MAX_US (1000 + 2 * BENCH_PASS_US)
+#define BENCH_RATE_S 2      // Full 1 s reports_per_s window in the middle
+#define BENCH_SPIN_COUNTS 3 // Encoder counts per pass, mouse and axes move
+#define BENCH_RATE_MIN 990  // reports_per_s out of 1000 frames
+
+uint32_t bench_pressed;             // Switches held, by index
+uint32_t bench_pending;             // Flips not reported yet
+uint64_t bench_edge[SW_GPIO_SIZE];  // When each switch last flipped
+uint64_t bench_latency_sum;
+uint32_t bench_latency_max;
+uint32_t bench_edges;
+
+/**
+ * Catches the first report on the main interface carrying each flip
+ **/
+void bench_hook(uint8_t instance, const fake_hid_report_t* r) {
+  if (instance != ITF_NUM_HID) return;
+  uint32_t done = bench_pending & ~(report.buttons ^ bench_pressed);
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if (!(done & (1u << i))) continue;
+    uint32_t latency = r->time - bench_edge[i];
+    bench_latency_sum += latency;
+    if (latency > bench_latency_max) bench_latency_max = latency;
+    bench_edges++;
+  }
+  bench_pending &= ~done;
+}
+
+/**
+ * Flips a switch if it is out of its debounce window, so eager debounce
+ * passes every flip straight through
+ * @param i Switch index
+ * @param when Time of the flip in us, at or before now
+ **/
+void bench_flip_switch(int i, uint64_t when) {
+  if (when - bench_edge[i] < config.debounce_us + 1000) return;
+  bench_pressed ^= 1u << i;
+  bench_pending |= 1u << i;
+  fake_gpio_in ^= 1u << SW_GPIO[i];  // Pulled up, low when pressed
+  bench_edge[i] = when;
+}
+
+/**
+ * Flips a random switch, see bench_flip_switch
+ * @param when Time of the flip in us, at or before now
+ **/
+void bench_flip(uint64_t when) {
+  bench_flip_switch(test_range(0, SW_GPIO_SIZE - 1), when);
+}
+
+/**
+ * Reads LATENCY_PAGE_SCHED, clearing it if asked
+ * @param counts sent, suppressed for each report scheduler
+ * @param clear Reset the counters after reading
+ **/
+void bench_sched(uint32_t counts[][2], bool clear) {
+  uint8_t page = LATENCY_PAGE_SCHED;
+  uint8_t buffer[CFG_TUD_HID_EP_BUFSIZE];
+  tud_hid_set_report_cb(ITF_NUM_HID, REPORT_ID_LATENCY,
+                        HID_REPORT_TYPE_FEATURE, &page, 1);
+  CHECK_EQ(tud_hid_get_report_cb(ITF_NUM_HID, REPORT_ID_LATENCY,
+                                 HID_REPORT_TYPE_FEATURE, buffer,
+                                 sizeof(buffer)),
+           LATENCY_REPORT_SIZE);
+  memcpy(counts, &buffer[1], count_of(report_scheds) * 8);
+  if (clear) {
+    page |= 0x80;
+    tud_hid_set_report_cb(ITF_NUM_HID, REPORT_ID_LATENCY,
+                          HID_REPORT_TYPE_FEATURE, &page, 1);
+  }
+}
+
+/**
+ * One pass of the main loop
+ **/
+static inline void bench_pass() {
+  input_task();
+  update_lights();
+}
+
+int main(int argc, char** argv) {
+  bool key = argc > 1 && strcmp(argv[1], "key") == 0;
+  uint64_t seconds = argc > 2 ? strtoull(argv[2], NULL, 10) : 2;
+
+  init();
+  loop_mode = key ? &key_mode : &joy_mode;
+  joy_mode_check = !key;
+  fake_hid_hook = bench_hook;
+
+  // Latency, simulated time
+  // Flips land anywhere in a pass and wait for the next one to sample them.
+  // The first waits out the debounce window every switch starts in.
+  uint64_t next_flip = fake_time_us + config.debounce_us + 5000;
+  while (fake_time_us < seconds * 1000000) {
+    if (next_flip <= fake_time_us) {
+      bench_flip(next_flip);
+      next_flip += test_range(200, 1500);
+    }
+    bench_pass();
+    fake_time_us += BENCH_PASS_US;
+  }
+
+  // What the device reports about itself over REPORT_ID_LATENCY
+  uint8_t page = 0;
+  uint8_t buffer[CFG_TUD_HID_EP_BUFSIZE];
+  latency_stats_t fw;
+  tud_hid_set_report_cb(ITF_NUM_HID, REPORT_ID_LATENCY,
+                        HID_REPORT_TYPE_FEATURE, &page, 1);
+  CHECK_EQ(tud_hid_get_report_cb(ITF_NUM_HID, REPORT_ID_LATENCY,
+                                 HID_REPORT_TYPE_FEATURE, buffer,
+                                 sizeof(buffer)),
+           LATENCY_REPORT_SIZE);
+  memcpy(&fw, &buffer[1], sizeof(fw));
+
+  printf("%s: %" PRIu32 " edges, edge to report avg %.1f us, max %" PRIu32
+         " us\n",
+         key ? "key" : "joy", bench_edges,
+         bench_edges ? (double)bench_latency_sum / bench_edges : 0.0,
+         bench_latency_max);
+  printf("%s: firmware latency_max_us %" PRIu32 ", latency_count %" PRIu32
+         ", loops_per_ms %" PRIu32 ", reports_per_s %" PRIu32 " main, %" PRIu32
+         " mouse\n",
+         key ? "key" : "joy", fw.latency_max_us, fw.latency_count,
+         fw.loops_per_ms, fw.reports_per_s[ITF_NUM_HID],
+         fw.reports_per_s[ITF_NUM_HID_MOUSE]);
+
+  CHECK(bench_edges >= seconds * 100);
+  CHECK(bench_latency_max <= BENCH_LATENCY_MAX_US);
+  CHECK(fw.latency_count > 0);
+  CHECK(fw.latency_max_us <= bench_latency_max);
+  CHECK_EQ(fw.loops_per_ms, 1000 / BENCH_PASS_US);
+
+  // Idle, simulated time: one sent or suppressed per frame and scheduler
+  static const char* const sched_names[] = {"joy", "keyboard", "mouse"};
+  uint32_t counts[count_of(report_scheds)][2];
+  bench_sched(counts, true);
+  uint64_t idle_end = fake_time_us + seconds * 1000000;
+  while (fake_time_us < idle_end) {
+    bench_pass();
+    fake_time_us += BENCH_PASS_US;
+  }
+  bench_sched(counts, false);
+  for (int i = 0; i < count_of(report_scheds); i++) {
+    printf("%s: idle %s sent %" PRIu32 ", suppressed %" PRIu32 "\n",
+           key ? "key" : "joy", sched_names[i], counts[i][0], counts[i][1]);
+    CHECK(counts[i][1] <= seconds * 1000 + 1);
+    bool used = key ? report_scheds[i] != &joy_sched
+                    : report_scheds[i] == &joy_sched;
+    if (used) CHECK(counts[i][0] + counts[i][1] + 1 >= seconds * 1000);
+  }
+
+  // Rate, simulated time: buttons and knobs change every frame
+  uint64_t rate_end = fake_time_us + BENCH_RATE_S * 1000000;
+  uint64_t frame = fake_time_us / 1000;
+  while (fake_time_us < rate_end) {
+    if (fake_time_us / 1000 != frame) {
+      frame = fake_time_us / 1000;
+      bench_flip_switch(frame % SW_GPIO_SIZE, fake_time_us);
+    }
+    for (int i = 0; i < ENC_GPIO_SIZE; i++) enc_val[i] += BENCH_SPIN_COUNTS;
+    bench_pass();
+    fake_time_us += BENCH_PASS_US;
+  }
+  uint32_t rate[CFG_TUD_HID];
+  for (int i = 0; i < CFG_TUD_HID; i++) {
+    rate[i] = latency_stats.reports_per_s[i];
+  }
+  printf("%s: changing every frame, reports_per_s %" PRIu32
+         " main, %" PRIu32 " mouse\n",
+         key ? "key" : "joy", rate[ITF_NUM_HID], rate[ITF_NUM_HID_MOUSE]);
+  CHECK(rate[ITF_NUM_HID] >= BENCH_RATE_MIN && rate[ITF_NUM_HID] <= 1001);
+  if (key) {
+    CHECK(rate[ITF_NUM_HID_MOUSE] >= BENCH_RATE_MIN &&
+          rate[ITF_NUM_HID_MOUSE] <= 1001);
+  }
+
+  // Throughput, host clock
+  fake_time_real = true;
+  uint64_t start = time_us_64();
+  uint64_t end = start + BENCH_REAL_MS * 1000;
+  uint64_t passes = 0;
+  next_flip = start;
+  while (time_us_64() < end) {
+    if (time_us_64() >= next_flip) {
+      bench_flip(time_us_64());
+      next_flip += 1000;
+    }
+    bench_pass();
+    passes++;
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("%s: %.1f passes/ms on this host, %.0f ns/pass\n",
+         key ? "key" : "joy", passes * 1000.0 / elapsed,
+         elapsed * 1000.0 / passes);
+  return 0;
+}
@@ -0,0 +1,338 @@
+/**
+ * Replays switch traces through every debounce mode
+ * @author SpeedyPotato
+ *
+ * Usage: debounce_replay [--write file] [--seconds s] [--bounces n] [trace...]
+ *
+ * A trace is a text file of "time_us switch state" lines in time order,
+ * state 1 = pressed, # starts a comment. Without traces a seeded synthetic
+ * trace is used: presses and releases on every switch for --seconds (20), each
+ * edge followed by a burst of up to --bounces (DR_BOUNCES) bounces within
+ * DR_BURST_MAX_US. --write saves it, so it can be looked at or replayed
+ * elsewhere.
+ *
+ * Each mode in debounce_modes[] replays every trace in its own process, so
+ * modes always start from power on state, polled every DR_POLL_US the way
+ * input_task would. The real edges are the raw bursts which settle on a new
+ * state for DR_SETTLE_US, timed from their first raw edge. For each mode:
+ * - added press / release latency: first raw edge to the cooked edge
+ * - chatter: cooked edges beyond one per real edge
+ * - missed: real edges which never got a cooked edge
+ * The run fails if any mode chatters, misses an edge or adds more than
+ * DR_LATENCY_MAX_US, so a new mode has to pass before it can be appended.
+ **/
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define DR_POLL_US 20
+#define DR_SETTLE_US 5000
+#define DR_BOUNCES 8
+#define DR_BURST_MAX_US 2000
+#define DR_HOLD_MIN_US 20000
+#define DR_HOLD_MAX_US 120000
+#define DR_START_US 1000000  // Modes treat time 0 as long ago
+#define DR_LATENCY_MAX_US \
+  (SW_DEBOUNCE_TIME_US + DR_BURST_MAX_US + 2 * DR_POLL_US + 600)
+#define DR_EDGES_MAX 65536
+
+typedef struct {
+  uint64_t time;
+  uint8_t sw;
+  uint8_t state;
+} dr_edge_t;
+
+typedef struct {
+  uint32_t edges;  // Real edges
+  uint32_t cooked;
+  uint32_t chatter;
+  uint32_t missed;
+  uint64_t press_sum, release_sum;
+  uint32_t presses, releases;
+  uint32_t press_max, release_max;
+} dr_result_t;
+
+dr_edge_t dr_raw[DR_EDGES_MAX];
+int dr_raw_count;
+dr_edge_t dr_cooked[DR_EDGES_MAX];
+int dr_cooked_count;
+
+/**
+ * Appends an edge, dropping ones which don't change the switch
+ **/
+void dr_push(dr_edge_t* list, int* count, uint64_t time, int sw, int state) {
+  CHECK(*count < DR_EDGES_MAX);
+  int prev = 0;  // Switches start released
+  for (int i = *count - 1; i >= 0; i--) {
+    if (list[i].sw == sw) {
+      prev = list[i].state;
+      break;
+    }
+  }
+  if (prev == state) return;
+  list[(*count)++] = (dr_edge_t){time, sw, state};
+}
+
+/**
+ * Synthetic trace, switches interleaved and sorted by time
+ * @param length_us Length of the trace
+ * @param max_bounces Most bounces after an edge, at most DR_BOUNCES
+ **/
+void dr_synthetic(uint64_t length_us, int max_bounces) {
+  static dr_edge_t edges[DR_EDGES_MAX];
+  int count = 0;
+  for (int sw = 0; sw < SW_GPIO_SIZE; sw++) {
+    uint64_t t = DR_START_US + test_range(0, DR_HOLD_MAX_US);
+    int state = 0;
+    while (t < DR_START_US + length_us) {
+      state = !state;
+      CHECK(count + 2 * DR_BOUNCES + 1 < DR_EDGES_MAX);
+      edges[count++] = (dr_edge_t){t, sw, state};
+      int bounces = test_range(0, max_bounces);
+      uint64_t b = t;
+      for (int i = 0; i < bounces; i++) {
+        b += test_range(10, DR_BURST_MAX_US / DR_BOUNCES / 2);
+        edges[count++] = (dr_edge_t){b, sw, !state};
+        b += test_range(10, DR_BURST_MAX_US / DR_BOUNCES / 2);
+        edges[count++] = (dr_edge_t){b, sw, state};
+      }
+      t += test_range(DR_HOLD_MIN_US, DR_HOLD_MAX_US);
+    }
+  }
+  // Insertion sort, stable so each switch keeps its order
+  for (int i = 1; i < count; i++) {
+    dr_edge_t e = edges[i];
+    int j = i;
+    for (; j > 0 && edges[j - 1].time > e.time; j--) edges[j] = edges[j - 1];
+    edges[j] = e;
+  }
+  memcpy(dr_raw, edges, count * sizeof(dr_edge_t));
+  dr_raw_count = count;
+}
+
+/**
+ * Loads a trace file
+ * @return false if it can't be read
+ **/
+bool dr_load(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[128];
+  dr_raw_count = 0;
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long long time;
+    int sw, state;
+    if (line[0] == '#' || sscanf(line, "%llu %d %d", &time, &sw, &state) != 3) {
+      continue;
+    }
+    if (sw < 0 || sw >= SW_GPIO_SIZE) continue;
+    dr_push(dr_raw, &dr_raw_count, time, sw, state != 0);
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * Saves the current trace
+ * @param how How it was made, for the header
+ **/
+bool dr_write(const char* path, const char* how) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+  fprintf(f, "# %s\n# time_us switch state\n", how);
+  for (int i = 0; i < dr_raw_count; i++) {
+    fprintf(f, "%" PRIu64 " %d %d\n", dr_raw[i].time, dr_raw[i].sw,
+            dr_raw[i].state);
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * Polls the trace through one debounce mode, cooked edges go to dr_cooked
+ **/
+void dr_replay(int mode) {
+  config_default(&config);
+  config.debounce_mode = mode;
+  debounce_mode = debounce_modes[mode];
+
+  uint64_t end = dr_raw[dr_raw_count - 1].time + DR_LATENCY_MAX_US * 2;
+  int next = 0;
+  uint32_t raw = 0;
+  dr_cooked_count = 0;
+  for (uint64_t t = DR_START_US; t < end; t += DR_POLL_US) {
+    while (next < dr_raw_count && dr_raw[next].time <= t) {
+      raw = (raw & ~(1u << dr_raw[next].sw)) |
+            ((uint32_t)dr_raw[next].state << dr_raw[next].sw);
+      next++;
+    }
+    uint32_t cooked = sw_cooked_val;
+    sw_raw_val = raw;
+    sw_sample_time = t;
+    debounce_mode();
+    sw_prev_raw_val = sw_raw_val;
+    for (uint32_t c = cooked ^ sw_cooked_val; c != 0; c &= c - 1) {
+      int sw = __builtin_ctz(c);
+      CHECK(dr_cooked_count < DR_EDGES_MAX);
+      dr_cooked[dr_cooked_count++] =
+          (dr_edge_t){t, sw, (sw_cooked_val >> sw) & 1};
+    }
+  }
+}
+
+/**
+ * Compares the cooked edges with the real ones, switch by switch
+ **/
+dr_result_t dr_score() {
+  dr_result_t r = {0};
+  for (int sw = 0; sw < SW_GPIO_SIZE; sw++) {
+    // Real edges: bursts which settle on a new state
+    static dr_edge_t real[DR_EDGES_MAX / 4];
+    int nreal = 0;
+    int settled = 0;
+    uint64_t burst = 0;
+    int state = 0;
+    uint64_t last = 0;
+    for (int i = 0; i <= dr_raw_count; i++) {
+      if (i < dr_raw_count && dr_raw[i].sw != sw) continue;
+      uint64_t t = i < dr_raw_count ? dr_raw[i].time : UINT64_MAX;
+      if (last != 0 && t - last >= DR_SETTLE_US) {
+        if (state != settled) {
+          CHECK(nreal < (int)count_of(real));
+          real[nreal++] = (dr_edge_t){burst, sw, state};
+          settled = state;
+        }
+        burst = 0;
+      }
+      if (i == dr_raw_count) break;
+      if (burst == 0) burst = t;
+      state = dr_raw[i].state;
+      last = t;
+    }
+    r.edges += nreal;
+
+    // Each real edge owns the cooked edges up to the next real edge
+    int c = 0;
+    for (int k = -1; k < nreal; k++) {
+      uint64_t from = k < 0 ? 0 : real[k].time;
+      uint64_t to = k + 1 < nreal ? real[k + 1].time : UINT64_MAX;
+      bool matched = false;
+      for (; c < dr_cooked_count; c++) {
+        const dr_edge_t* e = &dr_cooked[c];
+        if (e->sw != sw) continue;
+        if (e->time >= to) break;
+        r.cooked++;
+        if (k >= 0 && !matched && e->state == real[k].state) {
+          matched = true;
+          uint32_t latency = e->time - from;
+          if (e->state) {
+            r.presses++;
+            r.press_sum += latency;
+            if (latency > r.press_max) r.press_max = latency;
+          } else {
+            r.releases++;
+            r.release_sum += latency;
+            if (latency > r.release_max) r.release_max = latency;
+          }
+        } else {
+          r.chatter++;
+        }
+      }
+      if (k >= 0 && !matched) r.missed++;
+    }
+  }
+  return r;
+}
+
+/**
+ * Replays the trace through a mode in a child process
+ **/
+dr_result_t dr_run(int mode) {
+  int fd[2];
+  CHECK(pipe(fd) == 0);
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    dr_replay(mode);
+    dr_result_t r = dr_score();
+    CHECK(write(fd[1], &r, sizeof(r)) == sizeof(r));
+    _exit(0);
+  }
+  dr_result_t r;
+  CHECK(read(fd[0], &r, sizeof(r)) == sizeof(r));
+  int status;
+  waitpid(pid, &status, 0);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  close(fd[0]);
+  close(fd[1]);
+  return r;
+}
+
+/**
+ * Replays the current trace through every mode
+ * @return false if a mode failed the gate
+ **/
+bool dr_all(const char* name) {
+  bool ok = true;
+  printf("%s: %d raw edges\n", name, dr_raw_count);
+  printf("  mode  edges cooked chatter missed  press avg/max us  release avg/max us\n");
+  for (int mode = 0; mode < (int)count_of(debounce_modes); mode++) {
+    dr_result_t r = dr_run(mode);
+    printf("  %4d %6" PRIu32 " %6" PRIu32 " %7" PRIu32 " %6" PRIu32
+           " %8.0f/%-8" PRIu32 " %8.0f/%-8" PRIu32 "\n",
+           mode, r.edges, r.cooked, r.chatter, r.missed,
+           r.presses ? (double)r.press_sum / r.presses : 0.0, r.press_max,
+           r.releases ? (double)r.release_sum / r.releases : 0.0,
+           r.release_max);
+    if (r.chatter || r.missed || r.press_max > DR_LATENCY_MAX_US ||
+        r.release_max > DR_LATENCY_MAX_US) {
+      fprintf(stderr, "%s: mode %d failed\n", name, mode);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  const char* out = NULL;
+  int seconds = 20;
+  int bounces = DR_BOUNCES;
+  int first = 1;
+  for (; first + 1 < argc && strncmp(argv[first], "--", 2) == 0; first += 2) {
+    if (strcmp(argv[first], "--write") == 0) {
+      out = argv[first + 1];
+    } else if (strcmp(argv[first], "--seconds") == 0) {
+      seconds = atoi(argv[first + 1]);
+    } else if (strcmp(argv[first], "--bounces") == 0) {
+      bounces = atoi(argv[first + 1]);
+    } else {
+      break;
+    }
+  }
+  if (seconds <= 0 || bounces < 0 || bounces > DR_BOUNCES) {
+    fprintf(stderr, "--seconds 1.. --bounces 0..%d\n", DR_BOUNCES);
+    return 1;
+  }
+
+  bool ok = true;
+  if (first >= argc) {
+    dr_synthetic(seconds * 1000000ull, bounces);
+    if (out) {
+      char how[128];
+      snprintf(how, sizeof(how),
+               "Synthetic, debounce_replay --write --seconds %d --bounces %d",
+               seconds, bounces);
+      if (!dr_write(out, how)) return 1;
+    }
+    ok = dr_all("synthetic");
+  }
+  for (int i = first; i < argc; i++) {
+    if (!dr_load(argv[i]) || dr_raw_count == 0) {
+      fprintf(stderr, "%s: no trace\n", argv[i]);
+      return 1;
+    }
+    ok &= dr_all(argv[i]);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+/**
+ * Fake Pico SDK and TinyUSB for the host build, see fake_sdk.h
+ * @author SpeedyPotato
+ **/
+#include "fake_sdk.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t fake_time_us;
+bool fake_time_real;
+uint32_t fake_gpio_in = 0xffffffffu;
+uint32_t fake_gpio_out;
+
+fake_hid_report_t fake_hid_last[CFG_TUD_HID];
+uint32_t fake_hid_count[CFG_TUD_HID];
+void (*fake_hid_hook)(uint8_t instance, const fake_hid_report_t* r);
+
+int64_t fake_flash_budget = -1;
+jmp_buf* fake_power_cut;
+jmp_buf* fake_panic;
+void (*fake_core1_entry)(void);
+
+uint8_t fake_flash[PICO_FLASH_SIZE_BYTES];
+pio_hw_t fake_pio_hw[NUM_PIOS];
+static dma_hw_t fake_dma_hw;
+dma_hw_t* dma_hw = &fake_dma_hw;
+fake_dma_channel_t fake_dma[NUM_DMA_CHANNELS];
+static systick_hw_t fake_systick_hw;
+systick_hw_t* systick_hw = &fake_systick_hw;
+
+static uint32_t pio_sm_claimed[NUM_PIOS];
+static uint32_t pio_used[NUM_PIOS];  // Instruction memory loaded so far
+static uint16_t pio_imem[NUM_PIOS][PIO_INSTRUCTION_COUNT];
+static pio_sm_config pio_config[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint sm_pc[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint32_t dma_claimed;
+static uint64_t hid_busy_until[CFG_TUD_HID];  // 0 when the endpoint is free
+static bool sof_enabled;
+static uint64_t sof_frame;
+static uint64_t real_start_ns;
+
+__attribute__((constructor)) static void fake_init(void) { fake_reset(); }
+
+void fake_reset(void) {
+  fake_time_us = 0;
+  fake_time_real = false;
+  fake_gpio_in = 0xffffffffu;
+  fake_gpio_out = 0;
+  memset(fake_hid_last, 0, sizeof(fake_hid_last));
+  memset(fake_hid_count, 0, sizeof(fake_hid_count));
+  memset(hid_busy_until, 0, sizeof(hid_busy_until));
+  fake_hid_hook = NULL;
+  fake_flash_budget = -1;
+  fake_power_cut = NULL;
+  fake_panic = NULL;
+  fake_core1_entry = NULL;
+  memset(fake_flash, 0xff, sizeof(fake_flash));
+  memset(fake_pio_hw, 0, sizeof(fake_pio_hw));
+  memset(pio_sm_claimed, 0, sizeof(pio_sm_claimed));
+  memset(pio_used, 0, sizeof(pio_used));
+  memset(pio_imem, 0, sizeof(pio_imem));
+  memset(pio_config, 0, sizeof(pio_config));
+  memset(&fake_dma_hw, 0, sizeof(fake_dma_hw));
+  memset(fake_dma, 0, sizeof(fake_dma));
+  dma_claimed = 0;
+  sof_enabled = false;
+  sof_frame = 0;
+}
+
+void panic(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  if (fake_panic == NULL) {
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    abort();
+  }
+  va_end(args);
+  longjmp(*fake_panic, 1);
+}
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+static uint64_t host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+uint64_t time_us_64(void) {
+  if (!fake_time_real) return fake_time_us;
+  if (real_start_ns == 0) real_start_ns = host_ns() - fake_time_us * 1000;
+  return (host_ns() - real_start_ns) / 1000;
+}
+
+void sleep_until(absolute_time_t t) {
+  if (fake_time_real) {
+    while (time_us_64() < t) {
+    }
+  } else if (t > fake_time_us) {
+    fake_time_us = t;
+  }
+}
+
+void sleep_us(uint64_t us) { sleep_until(time_us_64() + us); }
+void sleep_ms(uint32_t ms) { sleep_us(ms * 1000ull); }
+
+alarm_pool_t* alarm_pool_create(uint hardware_alarm_num, uint max_timers) {
+  (void)hardware_alarm_num;
+  (void)max_timers;
+  static int pool;
+  return (alarm_pool_t*)&pool;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t* pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void* user_data,
+                                       repeating_timer_t* out) {
+  (void)pool;
+  out->delay_us = delay_us;
+  out->callback = callback;
+  out->user_data = user_data;
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// IRQs, multicore, GPIO
+//--------------------------------------------------------------------+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+  (void)num;
+  (void)handler;
+}
+void irq_set_enabled(uint num, bool enabled) {
+  (void)num;
+  (void)enabled;
+}
+void irq_set_priority(uint num, uint8_t priority) {
+  (void)num;
+  (void)priority;
+}
+
+void multicore_launch_core1(void (*entry)(void)) { fake_core1_entry = entry; }
+
+uint32_t gpio_get_all(void) { return fake_gpio_in; }
+
+void gpio_put(uint gpio, bool value) {
+  fake_gpio_out = (fake_gpio_out & ~(1u << gpio)) | ((uint32_t)value << gpio);
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value) {
+  fake_gpio_out = (fake_gpio_out & ~mask) | (value & mask);
+}
+
+//--------------------------------------------------------------------+
+// PIO
+//--------------------------------------------------------------------+
+bool pio_can_add_program(PIO pio, const pio_program_t* program) {
+  return pio_used[pio_get_index(pio)] + program->length <=
+         PIO_INSTRUCTION_COUNT;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t* program) {
+  uint i = pio_get_index(pio);
+  if (!pio_can_add_program(pio, program)) {
+    panic("No program space");
+  }
+  uint offset = pio_used[i];
+  memcpy(&pio_imem[i][offset], program->instructions,
+         program->length * sizeof(uint16_t));
+  pio_used[i] += program->length;
+  return offset;
+}
+
+void pio_sm_claim(PIO pio, uint sm) {
+  uint32_t* claimed = &pio_sm_claimed[pio_get_index(pio)];
+  if (*claimed & (1u << sm)) panic("PIO %u SM %u already claimed",
+                                   pio_get_index(pio), sm);
+  *claimed |= 1u << sm;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+  pio_sm_claimed[pio_get_index(pio)] &= ~(1u << sm);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+  for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+    if (!pio_sm_is_claimed(pio, sm)) {
+      pio_sm_claim(pio, sm);
+      return sm;
+    }
+  }
+  if (required) panic("No PIO state machines are available");
+  return -1;
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+  return pio_sm_claimed[pio_get_index(pio)] & (1u << sm);
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* c) {
+  pio_config[pio_get_index(pio)][sm] = *c;
+  sm_pc[pio_get_index(pio)][sm] = initial_pc;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+  (void)pio;
+  (void)sm;
+  (void)enabled;
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+  (void)pio;
+  (void)sm;
+  (void)instr;
+}
+
+const pio_sm_config* fake_pio_sm_config(PIO pio, uint sm) {
+  return &pio_config[pio_get_index(pio)][sm];
+}
+
+uint fake_pio_sm_pc(PIO pio, uint sm) { return sm_pc[pio_get_index(pio)][sm]; }
+
+uint16_t fake_pio_instruction(PIO pio, uint offset) {
+  return pio_imem[pio_get_index(pio)][offset];
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+void dma_channel_claim(uint ch) {
+  if (dma_claimed & (1u << ch)) panic("DMA channel %u already claimed", ch);
+  dma_claimed |= 1u << ch;
+}
+
+void dma_channel_unclaim(uint ch) { dma_claimed &= ~(1u << ch); }
+
+int dma_claim_unused_channel(bool required) {
+  for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+    if (!dma_channel_is_claimed(ch)) {
+      dma_channel_claim(ch);
+      return ch;
+    }
+  }
+  if (required) panic("No DMA channels are available");
+  return -1;
+}
+
+bool dma_channel_is_claimed(uint ch) { return dma_claimed & (1u << ch); }
+
+void dma_channel_configure(uint ch, const dma_channel_config* c,
+                           volatile void* write_addr,
+                           const volatile void* read_addr,
+                           uint transfer_count, bool trigger) {
+  fake_dma[ch].config = *c;
+  fake_dma[ch].write_addr = write_addr;
+  fake_dma[ch].read_addr = read_addr;
+  fake_dma[ch].transfer_count = transfer_count;
+  fake_dma[ch].started = trigger;
+  dma_hw->ch[ch].transfer_count = transfer_count;
+}
+
+void dma_channel_set_read_addr(uint ch, const volatile void* read_addr,
+                               bool trigger) {
+  fake_dma[ch].read_addr = read_addr;
+  if (trigger) fake_dma[ch].started = true;
+}
+
+void dma_channel_set_trans_count(uint ch, uint32_t count, bool trigger) {
+  fake_dma[ch].transfer_count = count;
+  dma_hw->ch[ch].transfer_count = count;
+  if (trigger) fake_dma[ch].started = true;
+}
+
+void dma_channel_transfer_from_buffer_now(uint ch,
+                                          const volatile void* read_addr,
+                                          uint32_t count) {
+  fake_dma[ch].read_addr = read_addr;
+  fake_dma[ch].transfer_count = count;
+  fake_dma[ch].started = true;
+  fake_dma[ch].start_time = time_us_64();
+}
+
+void dma_channel_set_irq0_enabled(uint ch, bool enabled) {
+  fake_dma[ch].irq0_enabled = enabled;
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+/**
+ * Spends one byte of the power budget, cutting power when it runs out
+ **/
+static void flash_spend(void) {
+  if (fake_flash_budget < 0) return;
+  if (fake_flash_budget == 0) {
+    if (fake_power_cut == NULL) panic("Power cut without a landing");
+    fake_flash_budget = -1;
+    longjmp(*fake_power_cut, 1);
+  }
+  fake_flash_budget--;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE ||
+      flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+    panic("Unaligned flash erase %x+%zx", flash_offs, count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    flash_spend();
+    fake_flash[flash_offs + i] = 0xff;
+  }
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data,
+                         size_t count) {
+  if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE ||
+      flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+    panic("Unaligned flash program %x+%zx", flash_offs, count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    flash_spend();
+    fake_flash[flash_offs + i] &= data[i];  // NOR can only clear bits
+  }
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB
+//--------------------------------------------------------------------+
+void tud_task(void) {
+  uint64_t now = time_us_64();
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    if (hid_busy_until[i] != 0 && now >= hid_busy_until[i]) {
+      hid_busy_until[i] = 0;
+      if (tud_hid_report_complete_cb) {
+        tud_hid_report_complete_cb(i, fake_hid_last[i].data,
+                                   fake_hid_last[i].len);
+      }
+    }
+  }
+  if (sof_enabled && now / 1000 != sof_frame) {
+    sof_frame = now / 1000;
+    if (tud_sof_cb) tud_sof_cb(sof_frame & 0x7ff);
+  }
+}
+
+void tud_sof_cb_enable(bool en) { sof_enabled = en; }
+
+bool tud_hid_n_ready(uint8_t instance) {
+  // The host takes a report with the IN token of the next frame
+  return hid_busy_until[instance] == 0 ||
+         time_us_64() >= hid_busy_until[instance];
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const* report,
+                      uint16_t len) {
+  if (!tud_hid_n_ready(instance) || len > CFG_TUD_HID_EP_BUFSIZE - 1) {
+    return false;
+  }
+  uint64_t now = time_us_64();
+  fake_hid_report_t* r = &fake_hid_last[instance];
+  r->report_id = report_id;
+  r->len = len;
+  memcpy(r->data, report, len);
+  r->time = now;
+  fake_hid_count[instance]++;
+  hid_busy_until[instance] = (now / 1000 + 1) * 1000;
+  if (fake_hid_hook) fake_hid_hook(instance, r);
+  return true;
+}
+
+bool tud_hid_n_mouse_report(uint8_t instance, uint8_t report_id,
+                            uint8_t buttons, int8_t x, int8_t y,
+                            int8_t vertical, int8_t horizontal) {
+  int8_t report[5] = {(int8_t)buttons, x, y, vertical, horizontal};
+  return tud_hid_n_report(instance, report_id, report, sizeof(report));
+}
@@ -0,0 +1,635 @@
+/**
+ * Fake Pico SDK and TinyUSB for the host build
+ * @author SpeedyPotato
+ *
+ * Declares just enough of the SDK and TinyUSB for pico_game_controller.c and
+ * usb_descriptors.c to compile on Linux. Hardware with behaviour the
+ * firmware depends on is simulated in fake_sdk.c:
+ * - Time only moves when a test says so (fake_time_us), or follows the host
+ *   clock with fake_time_real.
+ * - gpio_get_all() returns fake_gpio_in, pulled up (all 1) by default.
+ * - HID reports are captured in fake_hid_last. An interface stays busy until
+ *   the next 1 ms frame after a report, and tud_task() completes it and calls
+ *   tud_sof_cb() like the real stack would.
+ * - Flash is a RAM array behind XIP_BASE with NOR semantics: erase sets a
+ *   sector to 0xff, program can only clear bits. fake_flash_budget cuts the
+ *   power after that many bytes were erased or programmed.
+ * - PIO instruction memory, state machines and DMA channels are allocated and
+ *   claimed like the real thing, so allocators can be tested. Nothing runs.
+ **/
+#ifndef FAKE_SDK_H_
+#define FAKE_SDK_H_
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CFG_TUSB_MCU 1
+#include "tusb_config.h"
+
+typedef unsigned int uint;
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define hard_assert(x) ((void)0)
+__attribute__((noreturn)) void panic(const char* fmt, ...);
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+typedef uint64_t absolute_time_t;
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t* rt);
+struct repeating_timer {
+  int64_t delay_us;
+  repeating_timer_callback_t callback;
+  void* user_data;
+};
+typedef struct alarm_pool alarm_pool_t;
+
+uint64_t time_us_64(void);
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) {
+  return t + us;
+}
+static inline int64_t absolute_time_diff_us(absolute_time_t from,
+                                            absolute_time_t to) {
+  return (int64_t)(to - from);
+}
+void sleep_until(absolute_time_t t);
+static inline void busy_wait_until(absolute_time_t t) { sleep_until(t); }
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+alarm_pool_t* alarm_pool_create(uint hardware_alarm_num, uint max_timers);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t* pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void* user_data, repeating_timer_t* out);
+
+//--------------------------------------------------------------------+
+// Clocks, IRQs, sync, multicore
+//--------------------------------------------------------------------+
+enum clock_index { clk_sys = 5 };
+static inline uint32_t clock_get_hz(enum clock_index clk) {
+  (void)clk;
+  return 125000000;
+}
+
+#define TIMER_IRQ_0 0
+#define USBCTRL_IRQ 5
+#define DMA_IRQ_0 11
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+typedef void (*irq_handler_t)(void);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+void irq_set_priority(uint num, uint8_t priority);
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+// A real fence, test_seqlock runs the seqlocks across threads
+static inline void __dmb(void) { __sync_synchronize(); }
+static inline void __wfi(void) {}
+static inline void __compiler_memory_barrier(void) {
+  __asm__ volatile("" ::: "memory");
+}
+static inline void __mem_fence_acquire(void) { __sync_synchronize(); }
+static inline void __mem_fence_release(void) { __sync_synchronize(); }
+static inline uint get_core_num(void) { return 0; }
+
+void multicore_launch_core1(void (*entry)(void));
+static inline void multicore_lockout_victim_init(void) {}
+static inline bool multicore_lockout_victim_is_initialized(uint core) {
+  (void)core;
+  return false;
+}
+static inline void multicore_lockout_start_blocking(void) {}
+static inline void multicore_lockout_end_blocking(void) {}
+
+typedef struct {
+  volatile uint32_t csr, rvr, cvr, calib;
+} systick_hw_t;
+extern systick_hw_t* systick_hw;
+
+static inline void board_init(void) {}
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+#define NUM_BANK0_GPIOS 30
+#define GPIO_IN 0
+#define GPIO_OUT 1
+#define GPIO_FUNC_SIO 5
+
+uint32_t gpio_get_all(void);
+static inline bool gpio_get(uint gpio) { return (gpio_get_all() >> gpio) & 1; }
+void gpio_put(uint gpio, bool value);
+void gpio_put_masked(uint32_t mask, uint32_t value);
+static inline void gpio_init(uint gpio) { (void)gpio; }
+static inline void gpio_init_mask(uint32_t mask) { (void)mask; }
+static inline void gpio_set_dir(uint gpio, bool out) {
+  (void)gpio;
+  (void)out;
+}
+static inline void gpio_set_dir_out_masked(uint32_t mask) { (void)mask; }
+static inline void gpio_set_dir_in_masked(uint32_t mask) { (void)mask; }
+static inline void gpio_pull_up(uint gpio) { (void)gpio; }
+static inline void gpio_set_function(uint gpio, int fn) {
+  (void)gpio;
+  (void)fn;
+}
+
+//--------------------------------------------------------------------+
+// PIO
+//--------------------------------------------------------------------+
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+#define PIO_FIFO_JOIN_NONE 0
+#define PIO_FIFO_JOIN_TX 1
+#define PIO_FIFO_JOIN_RX 2
+
+typedef struct {
+  io_rw_32 txf[NUM_PIO_STATE_MACHINES];
+  io_ro_32 rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+typedef pio_hw_t* PIO;
+extern pio_hw_t fake_pio_hw[NUM_PIOS];
+#define pio0 (&fake_pio_hw[0])
+#define pio1 (&fake_pio_hw[1])
+
+typedef struct pio_program {
+  const uint16_t* instructions;
+  uint8_t length;
+  int8_t origin;
+} pio_program_t;
+
+typedef struct {
+  float clkdiv;
+  uint in_base, jmp_pin, out_base, out_count, set_base, set_count;
+  uint sideset_base;
+  uint wrap_target, wrap;
+  bool in_shift_right, autopush;
+  uint push_threshold;
+  int fifo_join;
+} pio_sm_config;
+
+enum pio_src_dest {
+  pio_pins = 0,
+  pio_x = 1,
+  pio_y = 2,
+  pio_null = 3,
+  pio_pindirs = 4,
+  pio_exec_mov = 4,
+  pio_status = 5,
+  pio_pc = 5,
+  pio_isr = 6,
+  pio_osr = 7,
+};
+
+static inline uint pio_get_index(PIO pio) { return (uint)(pio - fake_pio_hw); }
+static inline PIO pio_get_instance(uint index) { return &fake_pio_hw[index]; }
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+  return pio_get_index(pio) * 8 + sm + (is_tx ? 0 : 4);
+}
+bool pio_can_add_program(PIO pio, const pio_program_t* program);
+uint pio_add_program(PIO pio, const pio_program_t* program);
+void pio_sm_claim(PIO pio, uint sm);
+void pio_sm_unclaim(PIO pio, uint sm);
+int pio_claim_unused_sm(PIO pio, bool required);
+bool pio_sm_is_claimed(PIO pio, uint sm);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* c);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+static inline void pio_sm_set_enabled_mask(PIO pio, uint32_t mask,
+                                           bool enabled) {
+  for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+    if (mask & (1u << sm)) pio_sm_set_enabled(pio, sm, enabled);
+  }
+}
+static inline void pio_sm_clear_fifos(PIO pio, uint sm) {
+  (void)pio;
+  (void)sm;
+}
+static inline void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+  pio->txf[sm] = data;
+}
+static inline void pio_gpio_init(PIO pio, uint pin) {
+  (void)pio;
+  (void)pin;
+}
+static inline void pio_sm_set_consecutive_pindirs(PIO pio, uint sm,
+                                                  uint pin_base,
+                                                  uint pin_count, bool out) {
+  (void)pio;
+  (void)sm;
+  (void)pin_base;
+  (void)pin_count;
+  (void)out;
+}
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+  pio_sm_config c = {.clkdiv = 1, .in_shift_right = true,
+                     .push_threshold = 32, .wrap = 31};
+  return c;
+}
+static inline void sm_config_set_wrap(pio_sm_config* c, uint wrap_target,
+                                      uint wrap) {
+  c->wrap_target = wrap_target;
+  c->wrap = wrap;
+}
+static inline void sm_config_set_in_pins(pio_sm_config* c, uint in_base) {
+  c->in_base = in_base;
+}
+static inline void sm_config_set_jmp_pin(pio_sm_config* c, uint pin) {
+  c->jmp_pin = pin;
+}
+static inline void sm_config_set_out_pins(pio_sm_config* c, uint base,
+                                          uint count) {
+  c->out_base = base;
+  c->out_count = count;
+}
+static inline void sm_config_set_set_pins(pio_sm_config* c, uint base,
+                                          uint count) {
+  c->set_base = base;
+  c->set_count = count;
+}
+static inline void sm_config_set_sideset_pins(pio_sm_config* c, uint base) {
+  c->sideset_base = base;
+}
+static inline void sm_config_set_in_shift(pio_sm_config* c, bool shift_right,
+                                          bool autopush, uint threshold) {
+  c->in_shift_right = shift_right;
+  c->autopush = autopush;
+  c->push_threshold = threshold;
+}
+static inline void sm_config_set_out_shift(pio_sm_config* c, bool shift_right,
+                                           bool autopull, uint threshold) {
+  (void)c;
+  (void)shift_right;
+  (void)autopull;
+  (void)threshold;
+}
+static inline void sm_config_set_clkdiv(pio_sm_config* c, float div) {
+  c->clkdiv = div;
+}
+static inline void sm_config_set_fifo_join(pio_sm_config* c, int join) {
+  c->fifo_join = join;
+}
+
+// Real encodings, so a test can look at instructions the firmware patches
+static inline uint pio_encode_jmp(uint addr) { return 0x0000 | addr; }
+static inline uint pio_encode_in(enum pio_src_dest src, uint count) {
+  return 0x4000 | ((src & 7u) << 5) | (count & 31u);
+}
+static inline uint pio_encode_mov(enum pio_src_dest dest,
+                                  enum pio_src_dest src) {
+  return 0xa000 | ((dest & 7u) << 5) | (src & 7u);
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+#define NUM_DMA_CHANNELS 12
+#define DMA_SIZE_8 0
+#define DMA_SIZE_16 1
+#define DMA_SIZE_32 2
+
+typedef struct {
+  volatile uint32_t read_addr, write_addr, transfer_count, ctrl_trig;
+  volatile uint32_t al1_ctrl, al1_read_addr, al1_write_addr,
+      al1_transfer_count_trig;
+  volatile uint32_t al2_ctrl, al2_transfer_count, al2_read_addr,
+      al2_write_addr_trig;
+  volatile uint32_t al3_ctrl, al3_write_addr, al3_transfer_count,
+      al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+  dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+  volatile uint32_t ints0, ints1;
+} dma_hw_t;
+extern dma_hw_t* dma_hw;
+
+typedef struct {
+  bool read_increment, write_increment, ring_write;
+  uint ring_size_bits, dreq, chain_to, size;
+} dma_channel_config;
+
+// What the firmware last set up on each channel
+typedef struct {
+  dma_channel_config config;
+  volatile void* write_addr;
+  const volatile void* read_addr;
+  uint32_t transfer_count;
+  bool started;
+  uint64_t start_time;  // time_us_64() of the last transfer_from_buffer_now
+  bool irq0_enabled;
+} fake_dma_channel_t;
+extern fake_dma_channel_t fake_dma[NUM_DMA_CHANNELS];
+
+static inline dma_channel_config dma_channel_get_default_config(uint ch) {
+  dma_channel_config c = {.read_increment = true, .chain_to = ch,
+                          .size = DMA_SIZE_32};
+  return c;
+}
+static inline void channel_config_set_read_increment(dma_channel_config* c,
+                                                     bool incr) {
+  c->read_increment = incr;
+}
+static inline void channel_config_set_write_increment(dma_channel_config* c,
+                                                      bool incr) {
+  c->write_increment = incr;
+}
+static inline void channel_config_set_dreq(dma_channel_config* c, uint dreq) {
+  c->dreq = dreq;
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config* c,
+                                                         uint size) {
+  c->size = size;
+}
+static inline void channel_config_set_ring(dma_channel_config* c, bool write,
+                                           uint size_bits) {
+  c->ring_write = write;
+  c->ring_size_bits = size_bits;
+}
+static inline void channel_config_set_chain_to(dma_channel_config* c,
+                                               uint chain_to) {
+  c->chain_to = chain_to;
+}
+static inline dma_channel_hw_t* dma_channel_hw_addr(uint ch) {
+  return &dma_hw->ch[ch];
+}
+void dma_channel_claim(uint ch);
+void dma_channel_unclaim(uint ch);
+int dma_claim_unused_channel(bool required);
+bool dma_channel_is_claimed(uint ch);
+void dma_channel_configure(uint ch, const dma_channel_config* c,
+                           volatile void* write_addr,
+                           const volatile void* read_addr,
+                           uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint ch, const volatile void* read_addr,
+                               bool trigger);
+void dma_channel_set_trans_count(uint ch, uint32_t count, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint ch,
+                                          const volatile void* read_addr,
+                                          uint32_t count);
+void dma_channel_set_irq0_enabled(uint ch, bool enabled);
+static inline void dma_channel_start(uint ch) { fake_dma[ch].started = true; }
+static inline bool dma_channel_is_busy(uint ch) {
+  (void)ch;
+  return false;
+}
+static inline void dma_channel_wait_for_finish_blocking(uint ch) { (void)ch; }
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+extern uint8_t fake_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)fake_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t* data,
+                         size_t count);
+
+//--------------------------------------------------------------------+
+// TinyUSB
+//--------------------------------------------------------------------+
+#define TU_ATTR_WEAK __attribute__((weak))
+#define TU_ATTR_PACKED __attribute__((packed))
+#define U16_TO_U8S_LE(u16) \
+  ((uint8_t)((u16) & 0xff)), ((uint8_t)(((u16) >> 8) & 0xff))
+#define U32_TO_U8S_LE(u32)                                        \
+  ((uint8_t)((u32) & 0xff)), ((uint8_t)(((u32) >> 8) & 0xff)),    \
+      ((uint8_t)(((u32) >> 16) & 0xff)), ((uint8_t)(((u32) >> 24) & 0xff))
+
+typedef enum {
+  HID_REPORT_TYPE_INVALID,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+#define RI_TYPE_MAIN 0
+#define RI_TYPE_GLOBAL 1
+#define RI_TYPE_LOCAL 2
+#define HID_REPORT_DATA_0(data)
+#define HID_REPORT_DATA_1(data) , (data)
+#define HID_REPORT_DATA_2(data) , U16_TO_U8S_LE(data)
+#define HID_REPORT_DATA_3(data) , U32_TO_U8S_LE(data)
+#define HID_REPORT_ITEM(data, tag, type, size) \
+  (((tag) << 4) | ((type) << 2) | (size)) HID_REPORT_DATA_##size(data)
+#define HID_INPUT(x) HID_REPORT_ITEM(x, 8, RI_TYPE_MAIN, 1)
+#define HID_OUTPUT(x) HID_REPORT_ITEM(x, 9, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION(x) HID_REPORT_ITEM(x, 10, RI_TYPE_MAIN, 1)
+#define HID_FEATURE(x) HID_REPORT_ITEM(x, 11, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION_END HID_REPORT_ITEM(x, 12, RI_TYPE_MAIN, 0)
+#define HID_USAGE_PAGE(x) HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE_PAGE_N(x, n) HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, n)
+#define HID_LOGICAL_MIN(x) HID_REPORT_ITEM(x, 1, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX(x) HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX_N(x, n) HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, n)
+#define HID_REPORT_SIZE(x) HID_REPORT_ITEM(x, 7, RI_TYPE_GLOBAL, 1)
+#define HID_REPORT_ID(x) HID_REPORT_ITEM(x, 8, RI_TYPE_GLOBAL, 1),
+#define HID_REPORT_COUNT(x) HID_REPORT_ITEM(x, 9, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE(x) HID_REPORT_ITEM(x, 0, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MIN(x) HID_REPORT_ITEM(x, 1, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MAX(x) HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, 1)
+
+#define HID_DATA (0 << 0)
+#define HID_CONSTANT (1 << 0)
+#define HID_ARRAY (0 << 1)
+#define HID_VARIABLE (1 << 1)
+#define HID_ABSOLUTE (0 << 2)
+#define HID_RELATIVE (1 << 2)
+#define HID_COLLECTION_PHYSICAL 0
+#define HID_COLLECTION_APPLICATION 1
+
+#define HID_USAGE_PAGE_DESKTOP 0x01
+#define HID_USAGE_PAGE_KEYBOARD 0x07
+#define HID_USAGE_PAGE_BUTTON 0x09
+#define HID_USAGE_PAGE_ORDINAL 0x0a
+#define HID_USAGE_PAGE_VENDOR 0xff00
+#define HID_USAGE_DESKTOP_POINTER 0x01
+#define HID_USAGE_DESKTOP_MOUSE 0x02
+#define HID_USAGE_DESKTOP_JOYSTICK 0x04
+#define HID_USAGE_DESKTOP_X 0x30
+#define HID_USAGE_DESKTOP_Y 0x31
+#define HID_USAGE_DESKTOP_WHEEL 0x38
+
+// Mouse {buttons, x, y, wheel, pan}, see tud_hid_n_mouse_report
+#define TUD_HID_REPORT_DESC_MOUSE(...)                                       \
+  HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP), HID_USAGE(HID_USAGE_DESKTOP_MOUSE), \
+      HID_COLLECTION(HID_COLLECTION_APPLICATION), __VA_ARGS__                \
+      HID_USAGE(HID_USAGE_DESKTOP_POINTER),                                  \
+      HID_COLLECTION(HID_COLLECTION_PHYSICAL), HID_REPORT_COUNT(5),          \
+      HID_REPORT_SIZE(8), HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE), \
+      HID_COLLECTION_END, HID_COLLECTION_END
+
+#define HID_KEY_A 0x04
+#define HID_KEY_B 0x05
+#define HID_KEY_C 0x06
+#define HID_KEY_D 0x07
+#define HID_KEY_E 0x08
+#define HID_KEY_F 0x09
+#define HID_KEY_G 0x0a
+#define HID_KEY_H 0x0b
+#define HID_KEY_I 0x0c
+#define HID_KEY_J 0x0d
+#define HID_KEY_K 0x0e
+#define HID_KEY_L 0x0f
+#define HID_KEY_M 0x10
+#define HID_KEY_N 0x11
+#define HID_KEY_O 0x12
+#define HID_KEY_P 0x13
+#define HID_KEY_Q 0x14
+#define HID_KEY_R 0x15
+#define HID_KEY_S 0x16
+#define HID_KEY_T 0x17
+#define HID_KEY_U 0x18
+#define HID_KEY_V 0x19
+#define HID_KEY_W 0x1a
+#define HID_KEY_X 0x1b
+#define HID_KEY_Y 0x1c
+#define HID_KEY_Z 0x1d
+#define HID_KEY_1 0x1e
+#define HID_KEY_2 0x1f
+#define HID_KEY_3 0x20
+#define HID_KEY_4 0x21
+#define HID_KEY_5 0x22
+#define HID_KEY_6 0x23
+#define HID_KEY_7 0x24
+#define HID_KEY_8 0x25
+#define HID_KEY_9 0x26
+#define HID_KEY_0 0x27
+#define HID_KEY_ENTER 0x28
+#define HID_KEY_ESCAPE 0x29
+#define HID_KEY_SPACE 0x2c
+#define HID_KEY_CONTROL_LEFT 0xe0
+#define HID_KEY_SHIFT_LEFT 0xe1
+#define HID_KEY_GUI_RIGHT 0xe7
+
+#define HID_ITF_PROTOCOL_NONE 0
+#define HID_ITF_PROTOCOL_KEYBOARD 1
+#define HID_ITF_PROTOCOL_MOUSE 2
+
+typedef struct TU_ATTR_PACKED {
+  uint8_t bLength;
+  uint8_t bDescriptorType;
+  uint16_t bcdUSB;
+  uint8_t bDeviceClass;
+  uint8_t bDeviceSubClass;
+  uint8_t bDeviceProtocol;
+  uint8_t bMaxPacketSize0;
+  uint16_t idVendor;
+  uint16_t idProduct;
+  uint16_t bcdDevice;
+  uint8_t iManufacturer;
+  uint8_t iProduct;
+  uint8_t iSerialNumber;
+  uint8_t bNumConfigurations;
+} tusb_desc_device_t;
+
+#define TUSB_DESC_DEVICE 0x01
+#define TUSB_DESC_CONFIGURATION 0x02
+#define TUSB_DESC_STRING 0x03
+#define TUSB_DESC_INTERFACE 0x04
+#define TUSB_DESC_ENDPOINT 0x05
+#define HID_DESC_TYPE_HID 0x21
+#define HID_DESC_TYPE_REPORT 0x22
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP 0x20
+
+#define TUD_CONFIG_DESC_LEN 9
+#define TUD_HID_DESC_LEN (9 + 9 + 7)
+#define TUD_HID_INOUT_DESC_LEN (9 + 9 + 7 + 7)
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len,    \
+                              _attribute, _power_ma)                         \
+  9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount,          \
+      config_num, _stridx, (uint8_t)(0x80 | (_attribute)), (_power_ma) / 2
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, \
+                           _epin, _epsize, _ep_interval)                      \
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, 3,                                    \
+      (uint8_t)((_boot_protocol) ? 1 : 0), _boot_protocol, _stridx, 9,         \
+      HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT,    \
+      U16_TO_U8S_LE(_report_desc_len), 7, TUSB_DESC_ENDPOINT, _epin, 3,        \
+      U16_TO_U8S_LE(_epsize), _ep_interval
+#define TUD_HID_INOUT_DESCRIPTOR(_itfnum, _stridx, _boot_protocol,          \
+                                 _report_desc_len, _epout, _epin, _epsize,  \
+                                 _ep_interval)                              \
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, 3,                                 \
+      (uint8_t)((_boot_protocol) ? 1 : 0), _boot_protocol, _stridx, 9,      \
+      HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, \
+      U16_TO_U8S_LE(_report_desc_len), 7, TUSB_DESC_ENDPOINT, _epout, 3,    \
+      U16_TO_U8S_LE(_epsize), _ep_interval, 7, TUSB_DESC_ENDPOINT, _epin,   \
+      3, U16_TO_U8S_LE(_epsize), _ep_interval
+
+static inline bool tusb_init(void) { return true; }
+void tud_task(void);
+static inline bool tud_mounted(void) { return true; }
+void tud_sof_cb_enable(bool en);
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const* report,
+                      uint16_t len);
+bool tud_hid_n_mouse_report(uint8_t instance, uint8_t report_id,
+                            uint8_t buttons, int8_t x, int8_t y,
+                            int8_t vertical, int8_t horizontal);
+
+// Application callbacks, weak so tests without the firmware still link
+TU_ATTR_WEAK void tud_hid_report_complete_cb(uint8_t instance,
+                                             uint8_t const* report,
+                                             uint16_t len);
+TU_ATTR_WEAK void tud_sof_cb(uint32_t frame_count);
+
+//--------------------------------------------------------------------+
+// Test controls
+//--------------------------------------------------------------------+
+extern uint64_t fake_time_us;  // Current time, while !fake_time_real
+extern bool fake_time_real;    // Follow the host's monotonic clock instead
+extern uint32_t fake_gpio_in;  // Pin levels gpio_get_all() returns
+extern uint32_t fake_gpio_out;
+
+typedef struct {
+  uint8_t report_id;
+  uint16_t len;
+  uint8_t data[CFG_TUD_HID_EP_BUFSIZE];
+  uint64_t time;  // time_us_64() when tud_hid_n_report was called
+} fake_hid_report_t;
+extern fake_hid_report_t fake_hid_last[CFG_TUD_HID];
+extern uint32_t fake_hid_count[CFG_TUD_HID];
+extern void (*fake_hid_hook)(uint8_t instance, const fake_hid_report_t* r);
+
+extern int64_t fake_flash_budget;  // Bytes until power is cut, < 0 for never
+extern jmp_buf* fake_power_cut;    // Where a power cut lands
+extern jmp_buf* fake_panic;        // Where panic() lands, aborts if NULL
+extern void (*fake_core1_entry)(void);
+
+/**
+ * Frees every PIO, DMA and flash resource and resets time and pins
+ **/
+void fake_reset(void);
+
+/**
+ * @param pio PIO block
+ * @param sm State machine
+ * @return Config and program counter from the last pio_sm_init
+ **/
+const pio_sm_config* fake_pio_sm_config(PIO pio, uint sm);
+uint fake_pio_sm_pc(PIO pio, uint sm);
+
+/**
+ * @param pio PIO block
+ * @param offset Instruction memory address
+ * @return Instruction pio_add_program loaded there
+ **/
+uint16_t fake_pio_instruction(PIO pio, uint offset);
+
+#endif /* FAKE_SDK_H_ */
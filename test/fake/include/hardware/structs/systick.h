@@ -0,0 +1,2 @@
+// Host build stand-in for the Pico SDK / TinyUSB header of the same name
+#include "fake_sdk.h"
@@ -0,0 +1,94 @@
+# Stands in for pioasm in the host build:
+#   cmake -DPIO=<file.pio> -DOUT=<file.pio.h> -P pioasm.cmake
+#
+# Emits what the firmware uses from a pioasm header: the program with one
+# zero word per instruction, so pio_can_add_program sees its real length,
+# public defines, public label offsets, wrap and every % c-sdk block verbatim.
+# Instructions are counted, not assembled.
+
+file(READ ${PIO} src)
+# Keep ; and [] out of CMake's list handling
+string(REPLACE ";" "<SEMI>" src "${src}")
+string(REPLACE "[" "<LB>" src "${src}")
+string(REPLACE "]" "<RB>" src "${src}")
+string(REPLACE "\n" ";" lines "${src}")
+
+get_filename_component(name ${PIO} NAME)
+set(out "// Generated from ${name} by test/fake/pioasm.cmake, do not edit\n")
+string(APPEND out "#pragma once\n\n#include \"hardware/pio.h\"\n")
+
+set(prog "")
+set(block "")
+macro(flush_program)
+  if(NOT prog STREQUAL "" AND NOT flushed)
+    if(wrap STREQUAL "")
+      math(EXPR wrap "${count} - 1")
+    endif()
+    string(APPEND out "\n#define ${prog}_wrap_target ${wrap_target}\n")
+    string(APPEND out "#define ${prog}_wrap ${wrap}\n${defines}\n")
+    string(REPEAT "0, " ${count} words)
+    string(APPEND out "static const uint16_t ${prog}_program_instructions[] = {${words}};\n\n")
+    string(APPEND out "static const struct pio_program ${prog}_program = {\n")
+    string(APPEND out "    .instructions = ${prog}_program_instructions,\n")
+    string(APPEND out "    .length = ${count},\n    .origin = -1,\n};\n\n")
+    string(APPEND out "static inline pio_sm_config ${prog}_program_get_default_config(uint offset) {\n")
+    string(APPEND out "    pio_sm_config c = pio_get_default_sm_config();\n")
+    string(APPEND out "    sm_config_set_wrap(&c, offset + ${prog}_wrap_target, offset + ${prog}_wrap);\n")
+    string(APPEND out "    return c;\n}\n")
+    set(flushed TRUE)
+  endif()
+endmacro()
+
+foreach(line IN LISTS lines)
+  if(NOT block STREQUAL "")
+    if(line MATCHES "^%}")
+      set(block "")
+    elseif(block STREQUAL "c-sdk")
+      string(REPLACE "<SEMI>" ";" line "${line}")
+      string(REPLACE "<LB>" "[" line "${line}")
+      string(REPLACE "<RB>" "]" line "${line}")
+      string(APPEND out "${line}\n")
+    endif()
+    continue()
+  endif()
+  if(line MATCHES "^% *([a-z-]+) *{")
+    set(block ${CMAKE_MATCH_1})
+    if(block STREQUAL "c-sdk")
+      flush_program()
+      string(APPEND out "\n")
+    endif()
+    continue()
+  endif()
+
+  string(REGEX REPLACE "<SEMI>.*$" "" line "${line}")
+  string(REGEX REPLACE "//.*$" "" line "${line}")
+  string(STRIP "${line}" line)
+  if(line STREQUAL "")
+    continue()
+  elseif(line MATCHES "^\\.program +([A-Za-z0-9_]+)")
+    flush_program()
+    set(prog ${CMAKE_MATCH_1})
+    set(count 0)
+    set(wrap_target 0)
+    set(wrap "")
+    set(defines "")
+    set(flushed FALSE)
+  elseif(line MATCHES "^\\.define +public +([A-Za-z0-9_]+) +(.+)$")
+    string(APPEND defines "#define ${prog}_${CMAKE_MATCH_1} ${CMAKE_MATCH_2}\n")
+  elseif(line MATCHES "^\\.wrap_target")
+    set(wrap_target ${count})
+  elseif(line MATCHES "^\\.wrap")
+    math(EXPR wrap "${count} - 1")
+  elseif(line MATCHES "^\\.")
+    # .side_set, .lang_opt, .origin and private defines don't matter here
+  elseif(line MATCHES "^(public +)?([A-Za-z_][A-Za-z0-9_]*):$")
+    if(CMAKE_MATCH_1)
+      string(APPEND defines "#define ${prog}_offset_${CMAKE_MATCH_2} ${count}u\n")
+    endif()
+  else()
+    math(EXPR count "${count} + 1")
+  endif()
+endforeach()
+flush_program()
+
+file(WRITE ${OUT} "${out}")
@@ -0,0 +1,57 @@
+/**
+ * Host test helpers
+ * @author SpeedyPotato
+ *
+ * Pulls in the whole firmware the way the device builds it, one translation
+ * unit with every *_include.h, so tests can reach its globals and static
+ * functions. main() is renamed to firmware_main so the test has its own.
+ **/
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define main firmware_main
+#include "pico_game_controller.c"
+#undef main
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #cond);                                                 \
+      exit(1);                                                        \
+    }                                                                 \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                   \
+  do {                                                                   \
+    long long a_ = (long long)(a), b_ = (long long)(b);                  \
+    if (a_ != b_) {                                                      \
+      fprintf(stderr, "%s:%d: %s == %s failed, %lld != %lld\n", __FILE__, \
+              __LINE__, #a, #b, a_, b_);                                 \
+      exit(1);                                                           \
+    }                                                                    \
+  } while (0)
+
+/**
+ * xorshift32, so random traces are the same on every run
+ **/
+static uint32_t test_seed = 2463534242u;
+static inline uint32_t test_rand() {
+  test_seed ^= test_seed << 13;
+  test_seed ^= test_seed >> 17;
+  test_seed ^= test_seed << 5;
+  return test_seed;
+}
+
+/**
+ * @return Uniform random number in [lo, hi]
+ **/
+static inline uint32_t test_range(uint32_t lo, uint32_t hi) {
+  return lo + test_rand() % (hi - lo + 1);
+}
+
+#endif /* TEST_H_ */
@@ -0,0 +1,206 @@
+/**
+ * Switch edge capture: state machine setup, DMA re-arm chain and the ring
+ * decoder, fed with made up rings
+ * @author SpeedyPotato
+ **/
+#include "test.h"
+
+#define TEST_HZ 125000000u
+
+/**
+ * @return Time of a record ticks after the state machine started
+ **/
+uint64_t test_capture_time(uint64_t start, uint64_t ticks) {
+  return start + ticks * switches_TICK_CYCLES / (TEST_HZ / 1000000);
+}
+
+/**
+ * Only the switch pins are sampled and the data channel re-arms itself
+ **/
+void test_init() {
+  fake_reset();
+  CHECK(sw_capture_init(pio1));
+  CHECK(sw_capture_active);
+  CHECK_EQ(sw_capture_pin_base, 4);
+
+  const pio_sm_config* c = fake_pio_sm_config(pio1, 0);
+  CHECK_EQ(c->in_base, 4);
+  uint sample = fake_pio_sm_pc(pio1, 0) + switches_offset_sample;
+  CHECK_EQ(fake_pio_instruction(pio1, sample), pio_encode_in(pio_pins, 24));
+
+  fake_dma_channel_t* data = &fake_dma[sw_capture_dma];
+  fake_dma_channel_t* ctrl = &fake_dma[sw_capture_ctrl];
+  CHECK(data->started);
+  CHECK(!ctrl->started);
+  CHECK_EQ(data->config.chain_to, sw_capture_ctrl);
+  CHECK_EQ(data->config.ring_size_bits, SW_CAPTURE_RING_BITS);
+  CHECK(ctrl->write_addr ==
+        &dma_hw->ch[sw_capture_dma].al1_transfer_count_trig);
+  CHECK_EQ(*(const uint32_t*)ctrl->read_addr, SW_CAPTURE_TRANSFERS);
+  CHECK_EQ(ctrl->transfer_count, 1);
+  CHECK(!ctrl->config.read_increment && !ctrl->config.write_increment);
+
+  // Nothing free, nothing left claimed
+  fake_reset();
+  for (int i = 0; i < NUM_DMA_CHANNELS - 1; i++) dma_claim_unused_channel(true);
+  CHECK(!sw_capture_init(pio1));
+  CHECK(!pio_sm_is_claimed(pio1, 0));
+  CHECK(!dma_channel_is_claimed(NUM_DMA_CHANNELS - 1));
+}
+
+/**
+ * WS2812B data and encoder pins must not be sampled
+ **/
+void test_window() {
+  CHECK(sw_capture_window_clear(4, 24));
+  CHECK(!sw_capture_window_clear(4, 25));  // WS2812B_GPIO
+  CHECK(!sw_capture_window_clear(3, 25));  // ENC_GPIO[1] + 1
+  CHECK(!sw_capture_window_clear(1, 1));   // ENC_GPIO[0] + 1
+  CHECK(sw_capture_window_clear(29, 1));
+}
+
+/**
+ * Times come out exact, to the us below, across a whole second of ticks
+ **/
+void test_decode_times() {
+  sw_capture_t c;
+  uint32_t ring[SW_CAPTURE_RING_WORDS];
+  sw_capture_reset(&c, 1000, TEST_HZ);
+
+  uint64_t ticks = 0;
+  uint32_t written = 0;
+  for (int i = 0; i < 2000; i++) {
+    ticks += test_range(1, 20000);
+    ring[written % SW_CAPTURE_RING_WORDS] = i;
+    ring[(written + 1) % SW_CAPTURE_RING_WORDS] = (uint32_t)-ticks;
+    written += 2;
+
+    uint32_t state;
+    uint64_t time;
+    uint64_t expect = test_capture_time(1000, ticks);
+    CHECK(sw_capture_decode(&c, ring, written, expect + 5, &state, &time));
+    CHECK_EQ(state, i);
+    CHECK_EQ(time, expect);
+    CHECK(!sw_capture_decode(&c, ring, written, expect + 5, &state, &time));
+  }
+  CHECK_EQ(c.overruns, 0);
+}
+
+/**
+ * Long quiet spells, past the 32 bit cycle path and past several laps of
+ * the PIO counter
+ **/
+void test_decode_gaps() {
+  sw_capture_t c;
+  uint32_t ring[SW_CAPTURE_RING_WORDS];
+  sw_capture_reset(&c, 0, TEST_HZ);
+
+  const uint64_t gaps[] = {
+      100, 30000000ull, 1ull << 32, (3ull << 32) + 12345, 7, 1ull << 33,
+  };
+  uint64_t ticks = 0;
+  uint32_t written = 0;
+  for (size_t i = 0; i < count_of(gaps); i++) {
+    ticks += gaps[i];
+    ring[written % SW_CAPTURE_RING_WORDS] = 0;
+    ring[(written + 1) % SW_CAPTURE_RING_WORDS] = (uint32_t)-ticks;
+    written += 2;
+
+    uint32_t state;
+    uint64_t time;
+    uint64_t expect = test_capture_time(0, ticks);
+    CHECK(sw_capture_decode(&c, ring, written, expect + 100, &state, &time));
+    CHECK_EQ(time, expect);
+  }
+}
+
+/**
+ * Word counts carry on across a DMA re-arm
+ **/
+void test_decode_rearm() {
+  sw_capture_t c;
+  uint32_t ring[SW_CAPTURE_RING_WORDS];
+  sw_capture_reset(&c, 0, TEST_HZ);
+  c.read = SW_CAPTURE_TRANSFERS - 2;
+
+  ring[SW_CAPTURE_RING_WORDS - 2] = 1;
+  ring[SW_CAPTURE_RING_WORDS - 1] = (uint32_t)-100;
+  ring[0] = 2;
+  ring[1] = (uint32_t)-200;
+
+  uint32_t state;
+  uint64_t time;
+  CHECK(sw_capture_decode(&c, ring, 2, 1000, &state, &time));
+  CHECK_EQ(state, 1);
+  CHECK_EQ(time, test_capture_time(0, 100));
+  CHECK(sw_capture_decode(&c, ring, 2, 1000, &state, &time));
+  CHECK_EQ(state, 2);
+  CHECK_EQ(time, test_capture_time(0, 200));
+  CHECK(!sw_capture_decode(&c, ring, 2, 1000, &state, &time));
+  CHECK_EQ(c.read, 2);
+}
+
+/**
+ * A lapped reader counts the lost records and resumes on a whole one
+ **/
+void test_decode_lap() {
+  sw_capture_t c;
+  uint32_t ring[SW_CAPTURE_RING_WORDS];
+  sw_capture_reset(&c, 0, TEST_HZ);
+
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < 40; i++) {
+    ring[written % SW_CAPTURE_RING_WORDS] = i;
+    ring[(written + 1) % SW_CAPTURE_RING_WORDS] = -(i + 1) * 10;
+    written += 2;
+  }
+  // Half a record more, the next state word already landed
+  ring[written % SW_CAPTURE_RING_WORDS] = 40;
+  written++;
+
+  uint32_t state;
+  uint64_t time;
+  CHECK(sw_capture_decode(&c, ring, written, 1000, &state, &time));
+  CHECK_EQ(c.overruns, 40 - SW_CAPTURE_RING_WORDS / 2 + 1);
+  CHECK_EQ(state, 40 - SW_CAPTURE_RING_WORDS / 2 + 1);
+  uint32_t expect = state + 1;
+  while (sw_capture_decode(&c, ring, written, 1000, &state, &time)) {
+    CHECK_EQ(state, expect);
+    expect++;
+  }
+  CHECK_EQ(expect, 40);
+}
+
+/**
+ * sw_capture_pop reads the DMA count and hands back gpio numbered bits
+ **/
+void test_pop() {
+  fake_reset();
+  CHECK(sw_capture_init(pio0));
+  uint64_t start = sw_capture.time;
+
+  uint32_t pins = ~0u >> 8;  // Pin 4 pressed, bit 0 is gpio 4
+  sw_capture_ring[0] = pins & ~1u;
+  sw_capture_ring[1] = (uint32_t)-1000;
+  dma_hw->ch[sw_capture_dma].transfer_count = SW_CAPTURE_TRANSFERS - 2;
+
+  uint32_t state;
+  uint64_t time;
+  fake_time_us = start + 500;
+  CHECK(sw_capture_pop(&state, &time));
+  CHECK_EQ(state, (pins & ~1u) << 4);
+  CHECK_EQ(time, test_capture_time(start, 1000));
+  CHECK(!sw_capture_pop(&state, &time));
+}
+
+int main() {
+  test_init();
+  test_window();
+  test_decode_times();
+  test_decode_gaps();
+  test_decode_rearm();
+  test_decode_lap();
+  test_pop();
+  printf("capture: ok\n");
+  return 0;
+}
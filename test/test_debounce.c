@@ -0,0 +1,217 @@
+/**
+ * Debounce modes on random switch traces
+ * @author SpeedyPotato
+ *
+ * debounce_vertical against debounce_eager: with every switch's edges at
+ * least DB_TEST_HOLD_US + a poll apart, eager lets every edge through when it
+ * is sampled and so must vertical. With edges closer than that, vertical may
+ * hold a switch longer than eager, so instead every change it lets through
+ * has to stay for debounce_us, and once the switches settle it has to end up
+ * on their state.
+ *
+ * debounce_adaptive on its own: clean switches shrink their window to
+ * SW_ADAPT_MIN_US, and a switch which then bounces for longer than that
+ * counts escapes, after which its window grows until the bounces stop
+ * getting through.
+ **/
+#include "test.h"
+
+#define DB_TEST_EDGES 200000
+#define DB_TEST_POLL_MAX_US 60
+#define DB_TEST_START_US 1000000
+// Longest vertical hold, debounce_us rounded up to whole ticks plus a tick
+#define DB_TEST_HOLD_US ((VC_TICKS + 1) * VC_TICK_US)
+
+static const uint32_t db_test_debounce_us[] = {1, 13, 1000, 8000, 20000};
+
+uint32_t db_raw;                        // Switch levels, pressed = 1
+uint64_t db_next_edge[SW_GPIO_SIZE];    // When each switch flips next
+uint64_t db_accepted[SW_GPIO_SIZE];     // When vertical last changed each
+uint32_t db_eager_cooked;
+uint32_t db_vertical_cooked;
+
+/**
+ * Clears both modes' state and sets the debounce time
+ **/
+void db_test_reset(uint32_t debounce_us) {
+  config_default(&config);
+  config.debounce_us = debounce_us;
+  memset(sw_timestamp, 0, sizeof(sw_timestamp));
+  memset(vc_bit, 0, sizeof(vc_bit));
+  vc_tick_timestamp = 0;
+  db_raw = 0;
+  db_eager_cooked = 0;
+  db_vertical_cooked = 0;
+  for (int i = 0; i < SW_GPIO_SIZE; i++) db_accepted[i] = 0;
+}
+
+/**
+ * Runs both modes on one sample
+ **/
+void db_test_sample(uint64_t now) {
+  sw_sample_time = now;
+  sw_raw_val = db_raw;
+  sw_cooked_val = db_eager_cooked;
+  debounce_eager();
+  db_eager_cooked = sw_cooked_val;
+  sw_cooked_val = db_vertical_cooked;
+  debounce_vertical();
+  uint32_t changed = sw_cooked_val ^ db_vertical_cooked;
+  db_vertical_cooked = sw_cooked_val;
+
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if (!(changed & (1u << i))) continue;
+    if (db_accepted[i] != 0) {
+      CHECK(now - db_accepted[i] >= config.debounce_us);
+    }
+    db_accepted[i] = now;
+  }
+}
+
+/**
+ * Flips switches at their next edge times and samples them at random poll
+ * intervals until edges have gone by
+ * @param gap Picks the time from one edge of a switch to its next
+ * @param edges Number of edges over all switches
+ * @param same Check vertical and eager agree with the switches every sample
+ * @return Time of the last sample
+ **/
+uint64_t db_test_run(uint32_t (*gap)(), int edges, bool same) {
+  uint64_t now = DB_TEST_START_US;
+  for (int i = 0; i < SW_GPIO_SIZE; i++) db_next_edge[i] = now + gap();
+  while (edges > 0) {
+    now += test_range(1, DB_TEST_POLL_MAX_US);
+    for (int i = 0; i < SW_GPIO_SIZE; i++) {
+      if (db_next_edge[i] > now) continue;
+      db_raw ^= 1u << i;
+      db_next_edge[i] += gap();
+      edges--;
+    }
+    db_test_sample(now);
+    if (same) {
+      CHECK_EQ(db_vertical_cooked, db_eager_cooked);
+      CHECK_EQ(db_vertical_cooked, db_raw);
+    }
+  }
+  return now;
+}
+
+/**
+ * @return Edge gap no mode can tell from a clean switch
+ **/
+uint32_t db_test_spaced() {
+  return DB_TEST_HOLD_US + DB_TEST_POLL_MAX_US +
+         test_range(0, 2 * config.debounce_us + 1000);
+}
+
+/**
+ * @return Edge gap of a bouncing switch: mostly well inside the debounce
+ * window, sometimes just either side of it, sometimes long presses
+ **/
+uint32_t db_test_bouncy() {
+  switch (test_rand() % 4) {
+    case 0:
+      return test_range(1, config.debounce_us / 4 + 1);
+    case 1:
+      return test_range(config.debounce_us / 2,
+                        DB_TEST_HOLD_US + VC_TICK_US);
+    case 2:
+      return test_range(config.debounce_us, 3 * config.debounce_us + 1000);
+    default:
+      return test_range(1, 100);
+  }
+}
+
+/**
+ * Spaced edges: vertical reports exactly what eager does, on every sample
+ **/
+void test_spaced() {
+  for (int d = 0; d < count_of(db_test_debounce_us); d++) {
+    db_test_reset(db_test_debounce_us[d]);
+    db_test_run(db_test_spaced, DB_TEST_EDGES, true);
+  }
+}
+
+/**
+ * Bouncing edges: vertical holds every change for debounce_us and both modes
+ * land on the switch state once it settles
+ **/
+void test_bouncy() {
+  for (int d = 0; d < count_of(db_test_debounce_us); d++) {
+    db_test_reset(db_test_debounce_us[d]);
+    uint64_t now = db_test_run(db_test_bouncy, DB_TEST_EDGES, false);
+    uint64_t settled = now + DB_TEST_HOLD_US;
+    while (now < settled + DB_TEST_POLL_MAX_US) {
+      now += test_range(1, DB_TEST_POLL_MAX_US);
+      db_test_sample(now);
+    }
+    CHECK_EQ(db_eager_cooked, db_raw);
+    CHECK_EQ(db_vertical_cooked, db_raw);
+  }
+}
+
+/**
+ * One press or release of switch 0 through debounce_adaptive, sampled every
+ * DB_TEST_POLL_MAX_US until long after it settles
+ * @param now Time of the edge, moved past the end of the press
+ * @param bounce_us Switch bounces every 100 us for this long after the edge
+ * @return Cooked changes
+ **/
+int db_adapt_edge(uint64_t* now, uint32_t bounce_us) {
+  uint64_t edge = *now;
+  uint32_t level = sw_raw_val ^ 1;
+  int changes = 0;
+  for (; *now < edge + 4 * config.debounce_us; *now += DB_TEST_POLL_MAX_US) {
+    uint32_t since = *now - edge;
+    sw_prev_raw_val = sw_raw_val;
+    sw_raw_val = since < bounce_us && (since / 100) % 2 ? level ^ 1 : level;
+    sw_sample_time = *now;
+    uint32_t cooked = sw_cooked_val;
+    debounce_adaptive();
+    changes += (cooked ^ sw_cooked_val) & 1;
+    CHECK(adapt[0].window_us >= SW_ADAPT_MIN_US);
+    CHECK(adapt[0].window_us <= config.debounce_us);
+  }
+  return changes;
+}
+
+/**
+ * Window shrinks on a clean switch, then grows back once it bounces
+ **/
+void test_adaptive() {
+  config_default(&config);
+  memset(adapt, 0, sizeof(adapt));
+  memset(adapt_bounce_timestamp, 0, sizeof(adapt_bounce_timestamp));
+  memset(sw_timestamp, 0, sizeof(sw_timestamp));
+  adapt_held = 0;
+  sw_raw_val = sw_prev_raw_val = sw_cooked_val = 0;
+  uint64_t now = DB_TEST_START_US;
+
+  for (int n = 0; n < 1000; n++) CHECK_EQ(db_adapt_edge(&now, 0), 1);
+  CHECK_EQ(adapt[0].window_us, SW_ADAPT_MIN_US);
+  CHECK_EQ(adapt[0].escapes, 0);
+  CHECK_EQ(adapt[0].bounces, 0);
+
+  // Bounces past the window get through as escapes at first
+  const uint32_t bounce_us = 3 * SW_ADAPT_MIN_US;
+  int chatter = 0;
+  for (int n = 0; n < 20; n++) chatter += db_adapt_edge(&now, bounce_us) - 1;
+  CHECK(chatter > 0);
+  CHECK(adapt[0].escapes > 0);
+  CHECK(adapt[0].window_us > bounce_us);
+  CHECK(adapt[0].bounce_max_us > 0);
+
+  // and not once the window has grown
+  uint32_t escapes = adapt[0].escapes;
+  for (int n = 0; n < 1000; n++) CHECK_EQ(db_adapt_edge(&now, bounce_us), 1);
+  CHECK_EQ(adapt[0].escapes, escapes);
+  CHECK(adapt[0].bounces > 0);
+}
+
+int main() {
+  test_spaced();
+  test_bouncy();
+  test_adaptive();
+  printf("debounce: ok\n");
+  return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * Encoder state machine allocation and encoder to gamepad axis mapping
+ * @author SpeedyPotato
+ **/
+#include "test.h"
+
+/**
+ * Every free state machine mask, PIO fit and encoder count: encoders get the
+ * free SMs of PIOs the program fits in, lowest PIO and SM first, each once,
+ * and enc_alloc only fails if there are too few
+ **/
+void test_alloc() {
+  for (int fit = 0; fit < 1 << NUM_PIOS; fit++) {
+    bool fits[NUM_PIOS];
+    for (int p = 0; p < NUM_PIOS; p++) fits[p] = (fit >> p) & 1;
+    for (int mask = 0; mask < 1 << (4 * NUM_PIOS); mask++) {
+      uint8_t free_sm[NUM_PIOS];
+      enc_slot_t expect[4 * NUM_PIOS];
+      int avail = 0;
+      for (int p = 0; p < NUM_PIOS; p++) {
+        free_sm[p] = (mask >> (4 * p)) & 0xf;
+        for (int sm = 0; sm < 4 && fits[p]; sm++) {
+          if (free_sm[p] & (1u << sm)) expect[avail++] = (enc_slot_t){p, sm};
+        }
+      }
+      for (int n = 0; n <= 4 * NUM_PIOS; n++) {
+        enc_slot_t slots[4 * NUM_PIOS];
+        CHECK_EQ(enc_alloc(n, free_sm, fits, slots), n <= avail);
+        for (int e = 0; e < n && e < avail; e++) {
+          CHECK_EQ(slots[e].pio, expect[e].pio);
+          CHECK_EQ(slots[e].sm, expect[e].sm);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * init gives every encoder its own state machine and DMA channels
+ **/
+void test_init_slots() {
+  init();
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    CHECK(enc_slot[i].pio < NUM_PIOS && enc_slot[i].sm < 4);
+    CHECK(enc_slot[i].ctrl != enc_slot[i].dma);
+    for (int j = 0; j < i; j++) {
+      CHECK(enc_slot[i].pio != enc_slot[j].pio ||
+            enc_slot[i].sm != enc_slot[j].sm);
+      CHECK(enc_slot[i].dma != enc_slot[j].dma);
+      CHECK(enc_slot[i].ctrl < 0 || enc_slot[i].ctrl != enc_slot[j].ctrl);
+      CHECK(enc_slot[i].dma != enc_slot[j].ctrl);
+      CHECK(enc_slot[i].ctrl != enc_slot[j].dma);
+    }
+  }
+}
+
+/**
+ * Every position in [0, ENC_PULSE) gives floor(pos * 2^JOY_AXIS_BITS /
+ * ENC_PULSE), the axis never steps back or by more than one position's worth,
+ * and a revolution covers the whole axis from 0 to the last step before it
+ * wraps
+ **/
+void test_axis_sweep() {
+  const uint32_t step = ((1u << JOY_AXIS_BITS) + ENC_PULSE - 1) / ENC_PULSE;
+  joy_axis_t prev = 0;
+  for (int pos = 0; pos < ENC_PULSE; pos++) {
+    joy_axis_t axis = enc_axis(pos);
+    CHECK_EQ(axis, ((uint64_t)pos << JOY_AXIS_BITS) / ENC_PULSE);
+    CHECK(axis <= JOY_AXIS_MAX);
+    if (pos > 0) {
+      CHECK(axis >= prev);
+      CHECK(axis - prev <= step);
+    }
+    prev = axis;
+  }
+  CHECK_EQ(enc_axis(0), 0);
+  CHECK(enc_axis(ENC_PULSE - 1) + step >= (1u << JOY_AXIS_BITS));
+}
+
+/**
+ * Turned one count at a time through joy_mode, both ways and over the wrap,
+ * report.joy follows the knob
+ **/
+void test_joy_sweep() {
+  init();
+  for (int dir = -1; dir <= 1; dir += 2) {
+    int pos = cur_enc_val[0];
+    for (int n = 0; n < 2 * ENC_PULSE + 1; n++) {
+      enc_val[0] += dir;
+      pos = (pos + (enc_rev(0) ? dir : -dir) + ENC_PULSE) % ENC_PULSE;
+      fake_time_us += 1000;  // Endpoint free again
+      tud_task();
+      joy_mode();
+      CHECK_EQ(cur_enc_val[0], pos);
+      CHECK_EQ(report.joy[0], ((uint64_t)pos << JOY_AXIS_BITS) / ENC_PULSE);
+    }
+  }
+}
+
+int main() {
+  test_alloc();
+  test_init_slots();
+  test_axis_sweep();
+  test_joy_sweep();
+  printf("encoder: ok\n");
+  return 0;
+}
@@ -0,0 +1,251 @@
+/**
+ * Flash key/value store, including power cuts at every byte of a write
+ * @author SpeedyPotato
+ **/
+#include <setjmp.h>
+
+#include "test.h"
+
+#define KV_TEST_KEYS 8
+#define KV_TEST_LEN 40
+#define KV_TEST_STRIDE 61  // Cut spacing in the bulk of a compaction
+
+uint8_t kv_test_before[2 * FLASH_SECTOR_SIZE];
+
+/**
+ * Test value of a key, different for each generation
+ **/
+void kv_test_value(uint8_t key, uint32_t gen, uint8_t* value) {
+  for (int i = 0; i < KV_TEST_LEN; i++) value[i] = key * 31 + gen * 7 + i;
+}
+
+/**
+ * @return Generation stored for key, -1 if none or not a test value
+ **/
+int kv_test_gen(uint8_t key, int max_gen) {
+  const uint8_t* v = kv_get(key, KV_TEST_LEN);
+  if (v == NULL) return -1;
+  for (int gen = 0; gen <= max_gen; gen++) {
+    uint8_t expect[KV_TEST_LEN];
+    kv_test_value(key, gen, expect);
+    if (memcmp(v, expect, KV_TEST_LEN) == 0) return gen;
+  }
+  return -2;
+}
+
+/**
+ * @return Bytes of flash a write takes
+ **/
+int64_t kv_test_cost(uint8_t key, const uint8_t* value) {
+  memcpy(kv_test_before, kv_sector(0), sizeof(kv_test_before));
+  uint32_t active = kv_active, seq = kv_seq, tail = kv_tail;
+  fake_flash_budget = INT64_MAX;
+  CHECK(kv_set(key, value, KV_TEST_LEN));
+  int64_t cost = INT64_MAX - fake_flash_budget;
+  fake_flash_budget = -1;
+  memcpy((uint8_t*)kv_sector(0), kv_test_before, sizeof(kv_test_before));
+  kv_active = active;
+  kv_seq = seq;
+  kv_tail = tail;
+  return cost;
+}
+
+/**
+ * Cuts power after every possible number of bytes of one write, every
+ * KV_TEST_STRIDE bytes through the erase and copy of a compaction, whose
+ * header page comes last. After each reboot the key holds its old or new
+ * value, every other key is untouched, and the store still takes writes.
+ * @param gens Generation of every key before the write
+ **/
+void kv_test_cuts(uint8_t key, const int* gens) {
+  uint8_t value[KV_TEST_LEN];
+  kv_test_value(key, gens[key] + 1, value);
+  int64_t cost = kv_test_cost(key, value);
+  CHECK(cost > 0);
+  memcpy(kv_test_before, kv_sector(0), sizeof(kv_test_before));
+  uint8_t snapshot[2 * FLASH_SECTOR_SIZE];
+  memcpy(snapshot, kv_test_before, sizeof(snapshot));
+
+  for (int64_t budget = 0; budget < cost;
+       budget += budget + FLASH_PAGE_SIZE < cost ? KV_TEST_STRIDE : 1) {
+    memcpy((uint8_t*)kv_sector(0), snapshot, sizeof(snapshot));
+    kv_init();
+    jmp_buf cut;
+    fake_power_cut = &cut;
+    fake_flash_budget = budget;
+    if (setjmp(cut) == 0) {
+      kv_set(key, value, KV_TEST_LEN);
+      CHECK(false);  // The budget runs out first
+    }
+    fake_power_cut = NULL;
+
+    kv_init();
+    for (int k = 1; k <= KV_TEST_KEYS; k++) {
+      int gen = kv_test_gen(k, gens[k] + 1);
+      if (k == key && gens[k] >= 0) {
+        CHECK(gen == gens[k] || gen == gens[k] + 1);
+      } else if (k == key) {
+        CHECK(gen == -1 || gen == 0);
+      } else {
+        CHECK_EQ(gen, gens[k]);
+      }
+    }
+    CHECK(kv_set(key, value, KV_TEST_LEN));
+    CHECK_EQ(kv_test_gen(key, gens[key] + 1), gens[key] + 1);
+  }
+
+  // Leave the write done for the next step
+  memcpy((uint8_t*)kv_sector(0), snapshot, sizeof(snapshot));
+  kv_init();
+  CHECK(kv_set(key, value, KV_TEST_LEN));
+}
+
+/**
+ * Values read back, unchanged values never touch flash, and compaction
+ * keeps the newest value of every key
+ **/
+void test_basic() {
+  fake_reset();
+  kv_init();
+  CHECK_EQ(kv_active, -1);
+  CHECK(kv_get(1, 1) == NULL);
+  CHECK_EQ(kv_get_u8(1, 7), 7);
+
+  CHECK(kv_set_u8(1, 3));
+  CHECK_EQ(kv_get_u8(1, 7), 3);
+  CHECK(kv_get(1, 2) == NULL);  // Wrong length
+
+  fake_flash_budget = 1000000;
+  CHECK(kv_set_u8(1, 3));
+  CHECK_EQ(fake_flash_budget, 1000000);
+  fake_flash_budget = -1;
+
+  // Enough writes to go round both sectors several times
+  uint32_t seq = kv_seq;
+  uint8_t last[3];
+  for (int i = 0; i < 4000; i++) {
+    last[i % 3] = i;
+    CHECK(kv_set_u8(2 + i % 3, last[i % 3]));
+    CHECK_EQ(kv_get_u8(2 + i % 3, 0), last[i % 3]);
+  }
+  CHECK(kv_seq - seq >= 4);
+  kv_init();
+  CHECK_EQ(kv_get_u8(1, 7), 3);
+  for (int k = 0; k < 3; k++) CHECK_EQ(kv_get_u8(2 + k, 0), last[k]);
+}
+
+/**
+ * Writes a key without power cuts
+ **/
+void kv_test_write(uint8_t key, int* gens) {
+  uint8_t value[KV_TEST_LEN];
+  kv_test_value(key, ++gens[key], value);
+  CHECK(kv_set(key, value, KV_TEST_LEN));
+}
+
+/**
+ * Power cuts during the first write, appends and a compaction
+ **/
+void test_power_cuts() {
+  fake_reset();
+  kv_init();
+  int gens[KV_TEST_KEYS + 1];
+  for (int k = 0; k <= KV_TEST_KEYS; k++) gens[k] = -1;
+
+  // First write, which also creates the first sector
+  kv_test_cuts(1, gens);
+  gens[1]++;
+
+  // Appends of new keys and of a key which is already there
+  for (int key = 2; key <= 4; key++) {
+    kv_test_cuts(key, gens);
+    gens[key]++;
+  }
+  kv_test_cuts(1, gens);
+  gens[1]++;
+
+  // Fill the sector, so the next write compacts
+  uint32_t size = sizeof(kv_record_t) + KV_ALIGN(KV_TEST_LEN);
+  for (int i = 0; kv_tail + size <= FLASH_SECTOR_SIZE; i++) {
+    kv_test_write(1 + i % KV_TEST_KEYS, gens);
+  }
+  uint32_t seq = kv_seq;
+  kv_test_cuts(2, gens);
+  gens[2]++;
+  CHECK_EQ(kv_seq, seq + 1);
+
+  // And an append into the compacted sector
+  kv_test_cuts(5, gens);
+  gens[5]++;
+}
+
+/**
+ * Compaction drops the retired KV_BOOT_TURBOCHARGER left by older firmware
+ **/
+void test_retired() {
+  fake_reset();
+  kv_init();
+  CHECK(kv_set_u8(KV_BOOT_TURBOCHARGER, 1));
+  CHECK(kv_set_u8(KV_BOOT_KEY_MODE, 1));
+  CHECK(kv_get(KV_BOOT_TURBOCHARGER, 1) != NULL);
+
+  kv_tail = 0;  // Next write compacts
+  CHECK(kv_set_u8(KV_BOOT_RGB_OFF, 1));
+  kv_init();
+  CHECK(kv_get(KV_BOOT_TURBOCHARGER, 1) == NULL);
+  CHECK_EQ(kv_get_u8(KV_BOOT_KEY_MODE, 0), 1);
+  CHECK_EQ(kv_get_u8(KV_BOOT_RGB_OFF, 0), 1);
+}
+
+/**
+ * Powers the controller up on the flash it was left with
+ * @param held Switch indices held while plugging in, as a mask
+ * @return Flash bytes init erased or programmed
+ **/
+int64_t kv_test_boot(uint32_t held) {
+  static uint8_t flash[2 * FLASH_SECTOR_SIZE];
+  memcpy(flash, kv_sector(0), sizeof(flash));
+  fake_reset();
+  memcpy((uint8_t*)kv_sector(0), flash, sizeof(flash));
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if (held & (1u << i)) fake_gpio_in &= ~(1u << SW_GPIO[i]);
+  }
+  fake_flash_budget = 1000000;
+  init();
+  int64_t writes = 1000000 - fake_flash_budget;
+  fake_flash_budget = -1;
+  return writes;
+}
+
+/**
+ * Boots with no button held leave flash alone, holding a boot mode button
+ * toggles its saved mode once
+ **/
+void test_boot_modes() {
+  fake_reset();
+  for (int n = 0; n < 3; n++) {
+    CHECK_EQ(kv_test_boot(0), 0);
+    CHECK(loop_mode == &joy_mode);
+  }
+  CHECK(kv_get(KV_BOOT_KEY_MODE, 1) == NULL);
+
+  CHECK(kv_test_boot(1u << 0) > 0);
+  CHECK(loop_mode == &key_mode);
+  CHECK_EQ(kv_get_u8(KV_BOOT_KEY_MODE, 0), 1);
+  CHECK(kv_get(KV_BOOT_RGB_OFF, 1) == NULL);
+
+  CHECK_EQ(kv_test_boot(0), 0);
+  CHECK(loop_mode == &key_mode);
+  CHECK(kv_test_boot(1u << 0) > 0);
+  CHECK(loop_mode == &joy_mode);
+  CHECK_EQ(kv_get_u8(KV_BOOT_KEY_MODE, 1), 0);
+}
+
+int main() {
+  test_basic();
+  test_retired();
+  test_power_cuts();
+  test_boot_modes();
+  printf("kv_store: ok\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * Core 0 to core 1 lighting handoff
+ * @author SpeedyPotato
+ **/
+#include "test.h"
+
+/**
+ * Still encoders leave the lock alone, so core 1 can always copy
+ **/
+void test_publish_on_change() {
+  uint32_t seq = lights_lock.seq;
+  for (int i = 0; i < 100; i++) publish_lights_state();
+  CHECK_EQ(lights_lock.seq, seq);
+
+  enc_val[1] += 3;
+  publish_lights_state();
+  CHECK_EQ(lights_lock.seq, seq + 2);
+  CHECK_EQ(lights_shared.enc_val[1], enc_val[1]);
+  publish_lights_state();
+  CHECK_EQ(lights_lock.seq, seq + 2);
+
+  lights_state_t state;
+  CHECK(seqlock_read(&lights_lock, &state, &lights_shared, sizeof(state)));
+  CHECK_EQ(state.enc_val[1], enc_val[1]);
+}
+
+/**
+ * Pixel frames reach core 1 on PIXELS_SHOW only, over their own lock, from
+ * the OUT endpoint whatever report type the stack passes with ID 0
+ **/
+void test_pixels() {
+  fake_time_us += 5000;
+  uint32_t lights_seq = lights_lock.seq;
+  uint32_t seq = pixels_lock.seq;
+
+  // Fill LEDs 2..4 red, not shown yet
+  const uint8_t fill[] = {REPORT_ID_PIXELS, 0, 2, PIXELS_FILL | 3, 255, 0, 0};
+  tud_hid_set_report_cb(ITF_NUM_HID, 0, HID_REPORT_TYPE_INVALID, fill,
+                        sizeof(fill));
+  CHECK_EQ(pixels_lock.seq, seq);
+  pixels_fetch();
+  CHECK_EQ(pixels_frame->timestamp, 0);
+
+  // LED 0 blue and show
+  const uint8_t show[] = {REPORT_ID_PIXELS, PIXELS_SHOW, 0, 1, 0, 0, 255};
+  tud_hid_set_report_cb(ITF_NUM_HID, 0, HID_REPORT_TYPE_OUTPUT, show,
+                        sizeof(show));
+  CHECK_EQ(pixels_lock.seq, seq + 2);
+  CHECK_EQ(lights_lock.seq, lights_seq);
+
+  pixels_frame_t* before = pixels_frame;
+  pixels_fetch();
+  CHECK(pixels_frame != before);
+  CHECK_EQ(pixels_frame->timestamp, fake_time_us);
+  CHECK_EQ(pixels_frame->rgb[0].b, 255);
+  CHECK_EQ(pixels_frame->rgb[1].r, 0);
+  CHECK_EQ(pixels_frame->rgb[4].r, 255);
+
+  // Nothing new, nothing copied
+  before = pixels_frame;
+  pixels_fetch();
+  CHECK(pixels_frame == before);
+
+  // A copy which overlaps a write keeps the last frame
+  seqlock_write_begin(&pixels_lock);
+  pixels_fetch();
+  CHECK(pixels_frame == before);
+  seqlock_write_end(&pixels_lock);
+}
+
+int main() {
+  init();
+  test_publish_on_change();
+  test_pixels();
+  printf("lights: ok\n");
+  return 0;
+}
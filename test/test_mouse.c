@@ -0,0 +1,138 @@
+/**
+ * Fixed point mouse output: no encoder count is ever lost
+ * @author SpeedyPotato
+ *
+ * mouse_axis on its own has to account for every Q8 count it is given, at any
+ * gain and however far past a report's range. mouse_report is then driven
+ * with random spins while the fake USB stack only takes one report per frame,
+ * so most reports fail or are skipped, and once the knobs stop and the
+ * accumulators drain, the mouse moved exactly as far as the knobs did.
+ **/
+#include "test.h"
+
+#define MOUSE_TEST_STEPS 1000000
+#define MOUSE_TEST_SPIN_US 2000000
+#define MOUSE_TEST_DRAIN_US 30000000
+#define MOUSE_TEST_POLL_US 50
+
+int64_t mouse_test_sum[2];  // Mouse counts in the reports the host took
+
+void mouse_test_hook(uint8_t instance, const fake_hid_report_t* r) {
+  if (instance != ITF_NUM_HID_MOUSE) return;
+  mouse_test_sum[0] += (int8_t)r->data[1];
+  mouse_test_sum[1] += (int8_t)r->data[2];
+}
+
+/**
+ * @return true once every count the knobs made has been sent
+ **/
+bool mouse_test_idle() {
+  for (int i = 0; i < 2; i++) {
+    if (prev_enc_val[i] != enc_val[i]) return false;
+    if (mouse_acc[i] <= -(1 << MOUSE_Q) || mouse_acc[i] >= (1 << MOUSE_Q)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Q8 counts in == counts out * 256 + what is left, outputs stay in range and
+ * only fractions or saturation are left behind
+ **/
+void test_axis() {
+  for (int sens = 1; sens <= 4; sens++) {
+    config.mouse_sens = sens;
+    int64_t acc = 0;
+    int64_t in = 0;
+    int64_t out = 0;
+    for (int n = 0; n < MOUSE_TEST_STEPS; n++) {
+      int32_t delta = (int32_t)test_range(0, 600) - 300;
+      if (test_rand() % 4 == 0) delta /= 50;  // Slow turns, below a count
+      uint32_t gain = test_range(1, 1024);
+      in += (int64_t)delta * sens * gain;
+      int8_t o = mouse_axis(&acc, delta, gain);
+      CHECK(o >= -MOUSE_REPORT_MAX && o <= MOUSE_REPORT_MAX);
+      if (o > -MOUSE_REPORT_MAX && o < MOUSE_REPORT_MAX) {
+        CHECK(acc > -(1 << MOUSE_Q) && acc < (1 << MOUSE_Q));
+      }
+      out += o;
+      CHECK_EQ(out * (1 << MOUSE_Q) + acc, in);
+    }
+  }
+  config_default(&config);
+}
+
+/**
+ * The curve in use matches its points, is continuous between them and flat
+ * past the last, and no curve slows down as the knob speeds up
+ **/
+void test_gain() {
+  const uint16_t* curve = mouse_accel_curves[MOUSE_ACCEL];
+  for (int i = 0; i < MOUSE_ACCEL_POINTS; i++) {
+    CHECK_EQ(mouse_gain(i << MOUSE_ACCEL_SHIFT), curve[i]);
+    CHECK_EQ(mouse_gain(-(i << MOUSE_ACCEL_SHIFT)), curve[i]);
+  }
+  uint32_t last = mouse_gain(0);
+  for (int32_t v = 1; v < (MOUSE_ACCEL_POINTS + 2) << MOUSE_ACCEL_SHIFT; v++) {
+    uint32_t g = mouse_gain(v);
+    CHECK(g + 1 >= last && g <= last + 1);
+    last = g;
+  }
+  for (int c = 0; c < count_of(mouse_accel_curves); c++) {
+    for (int i = 1; i < MOUSE_ACCEL_POINTS; i++) {
+      CHECK(mouse_accel_curves[c][i] >= mouse_accel_curves[c][i - 1]);
+    }
+  }
+}
+
+/**
+ * Random spins both ways, up to 200 counts per frame, so the faster ones
+ * saturate reports and fall behind
+ * @param sens config.mouse_sens
+ **/
+void test_report(int sens) {
+  fake_reset();
+  init();
+  config.mouse_sens = sens;
+  fake_hid_hook = mouse_test_hook;
+  memset(mouse_test_sum, 0, sizeof(mouse_test_sum));
+  memset(mouse_acc, 0, sizeof(mouse_acc));
+  int64_t moved[2] = {0};
+  int32_t speed[2] = {0};
+  uint32_t sent = 0;
+
+  uint64_t end = fake_time_us + MOUSE_TEST_SPIN_US;
+  while (fake_time_us < end) {
+    for (int i = 0; i < 2; i++) {
+      if (test_rand() % 200 == 0) speed[i] = (int32_t)test_range(0, 20) - 10;
+      enc_val[i] += speed[i];
+      moved[i] += speed[i];
+    }
+    tud_task();
+    sent += mouse_report();
+    fake_time_us += MOUSE_TEST_POLL_US;
+  }
+  CHECK(sent > 0);
+
+  // Knobs stopped, what's left comes out over the next frames
+  end = fake_time_us + MOUSE_TEST_DRAIN_US;
+  while (fake_time_us < end && !mouse_test_idle()) {
+    tud_task();
+    mouse_report();
+    fake_time_us += MOUSE_TEST_POLL_US;
+  }
+  for (int i = 0; i < 2; i++) {
+    // Only the linear curve moves the mouse by a fixed gain per count
+    if (MOUSE_ACCEL == 0) CHECK_EQ(mouse_test_sum[i], -moved[i] * sens);
+  }
+  CHECK(mouse_test_idle());
+}
+
+int main() {
+  test_axis();
+  test_gain();
+  for (int sens = 1; sens <= 3; sens++) test_report(sens);
+  printf("mouse: ok\n");
+  return 0;
+}
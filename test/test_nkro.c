@@ -0,0 +1,134 @@
+/**
+ * NKRO keymap against the per report builder it replaced, and keycode checks
+ * @author SpeedyPotato
+ *
+ * ref_nkro is keyboard_report's loop from before nkro_keymap_build. Both are
+ * fed random keymaps, keycodes 0-247 with the modifier ranges weighted up,
+ * and random button states, and have to build the same report byte for byte.
+ * Then both are timed on the host clock. That depends on the machine so it is
+ * only printed.
+ **/
+#include "test.h"
+
+#define NKRO_TEST_KEYMAPS 2000
+#define NKRO_TEST_STATES 500
+#define NKRO_BENCH_REPORTS 2000000
+
+/**
+ * The old builder, one pass over every switch per report
+ **/
+void ref_nkro(uint8_t nkro_report[32], const uint8_t* keycode,
+              uint32_t buttons) {
+  memset(nkro_report, 0, 32);
+  for (int i = 0; i < SW_GPIO_SIZE; i++) {
+    if ((buttons >> i) % 2 == 1) {
+      uint8_t bit = keycode[i] % 8;
+      uint8_t byte = (keycode[i] / 8) + 1;
+      if (keycode[i] >= 240 && keycode[i] <= 247) {
+        nkro_report[0] |= (1 << bit);
+      } else if (byte > 0 && byte <= 31) {
+        nkro_report[byte] |= (1 << bit);
+      }
+    }
+  }
+}
+
+/**
+ * @return Random keycode below KEYCODE_END, often a modifier
+ **/
+uint8_t nkro_test_keycode() {
+  switch (test_rand() % 4) {
+    case 0:
+      return test_range(224, 231);
+    case 1:
+      return test_range(240, KEYCODE_END - 1);
+    default:
+      return test_range(0, KEYCODE_END - 1);
+  }
+}
+
+/**
+ * Same report bytes as the old builder, with keys sharing bits too
+ **/
+void test_equivalence() {
+  uint8_t keycode[SW_GPIO_SIZE];
+  for (int m = 0; m < NKRO_TEST_KEYMAPS; m++) {
+    for (int i = 0; i < SW_GPIO_SIZE; i++) {
+      keycode[i] = i > 0 && test_rand() % 8 == 0 ? keycode[i - 1]
+                                                 : nkro_test_keycode();
+    }
+    nkro_keymap_build(keycode);
+    for (int s = 0; s < NKRO_TEST_STATES; s++) {
+      uint32_t buttons = test_rand() & ((1u << SW_GPIO_SIZE) - 1);
+      if (s == 0) buttons = 0;
+      if (s == 1) buttons = (1u << SW_GPIO_SIZE) - 1;
+      uint8_t expect[32];
+      uint32_t got[NKRO_REPORT_SIZE / 4];
+      ref_nkro(expect, keycode, buttons);
+      nkro_fill(got, buttons);
+      CHECK(memcmp(got, expect, sizeof(expect)) == 0);
+    }
+  }
+}
+
+/**
+ * Keycodes 248-255 are turned away over REPORT_ID_CONFIG, the rest are taken
+ **/
+void test_config_keycodes() {
+  init();
+  config_t before = config;
+  uint8_t buffer[CONFIG_REPORT_SIZE];
+  for (int keycode = 0; keycode <= 255; keycode++) {
+    config_t c = before;
+    c.keycode[SW_GPIO_SIZE - 1] = keycode;
+    buffer[0] = 0;
+    memcpy(&buffer[1], &c, CONFIG_SIZE);
+    tud_hid_set_report_cb(ITF_NUM_HID, REPORT_ID_CONFIG,
+                          HID_REPORT_TYPE_FEATURE, buffer, sizeof(buffer));
+    CHECK_EQ(config.keycode[SW_GPIO_SIZE - 1],
+             keycode < KEYCODE_END ? keycode : KEYCODE_END - 1);
+  }
+}
+
+/**
+ * Time per report of both builders over the same button states
+ **/
+void bench_nkro() {
+  fake_time_real = true;
+  uint8_t keycode[SW_GPIO_SIZE];
+  for (int i = 0; i < SW_GPIO_SIZE; i++) keycode[i] = nkro_test_keycode();
+  nkro_keymap_build(keycode);
+  static uint32_t states[1024];
+  for (int i = 0; i < 1024; i++) states[i] = test_rand() & 0x7ff;
+
+  // Sums the reports so neither loop is optimised away
+  uint32_t sink = 0;
+  uint64_t start = time_us_64();
+  for (int n = 0; n < NKRO_BENCH_REPORTS; n++) {
+    uint8_t r[32];
+    ref_nkro(r, keycode, states[n % 1024]);
+    sink += r[n % 32];
+  }
+  uint64_t ref_us = time_us_64() - start;
+  start = time_us_64();
+  for (int n = 0; n < NKRO_BENCH_REPORTS; n++) {
+    uint32_t r[NKRO_REPORT_SIZE / 4];
+    nkro_fill(r, states[n % 1024]);
+    sink += r[n % 8];
+  }
+  uint64_t fill_us = time_us_64() - start;
+  fake_time_real = false;
+
+  printf("nkro: old builder %.1f ns/report, keymap %.1f ns/report (%" PRIu32
+         ")\n",
+         ref_us * 1000.0 / NKRO_BENCH_REPORTS,
+         fill_us * 1000.0 / NKRO_BENCH_REPORTS, sink & 1);
+}
+
+int main() {
+  test_equivalence();
+  test_config_keycodes();
+  bench_nkro();
+  printf("nkro: ok\n");
+  return 0;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+tools/read_stats.py against synthetic feature reports laid out the way
+src/stats/histogram.c and src/stats/latency.c write them, with and without
+the report ID in front, sized from the firmware's own #defines. Needs no
+controller and no hidapi.
+"""
+import os
+import re
+import struct
+import sys
+import unittest
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+import read_stats  # noqa: E402
+
+
+def define(path, name):
+    """Value of a plain number #define in the firmware source."""
+    with open(os.path.join(ROOT, "src", path)) as f:
+        return int(re.search(r"#define %s (\d+)" % name, f.read()).group(1))
+
+
+STATS_REPORT_SIZE = define("usb_descriptors.h", "STATS_REPORT_SIZE")
+LATENCY_REPORT_SIZE = define("usb_descriptors.h", "LATENCY_REPORT_SIZE")
+HIST_BUCKETS = define("stats/histogram.c", "HIST_BUCKETS")
+
+
+def pad(report, size):
+    return report + bytes(size - len(report))
+
+
+def stats_report(metric, unit, hz, count, peak, buckets):
+    report = struct.pack("<BBBIII", metric, unit, len(buckets), hz, count,
+                         peak) + struct.pack("<%dH" % len(buckets), *buckets)
+    return pad(report, STATS_REPORT_SIZE)
+
+
+class DecodeTest(unittest.TestCase):
+    def test_stats(self):
+        buckets = [0] * HIST_BUCKETS
+        buckets[3], buckets[10], buckets[HIST_BUCKETS - 1] = 5, 65535, 1
+        report = stats_report(2, 0, 125000000, 123456, 0xdeadbeef, buckets)
+        for r in (report, bytes([read_stats.REPORT_ID_STATS]) + report):
+            stats = read_stats.decode(r)
+            self.assertEqual(stats["metric"], "tud_task")
+            self.assertEqual(stats["unit"], "cycles")
+            self.assertEqual(stats["hz"], 125000000)
+            self.assertEqual(stats["count"], 123456)
+            self.assertEqual(stats["max"], 0xdeadbeef)
+            self.assertEqual(list(stats["buckets"]), buckets)
+
+    def test_stats_us(self):
+        report = stats_report(4, 1, 125000000, 2, 1500, [1, 1])
+        stats = read_stats.decode(report)
+        self.assertEqual(stats["metric"], "report")
+        self.assertEqual(read_stats.to_us(1500, stats), 1500)
+        text = read_stats.format_stats(stats)
+        self.assertIn("report: 2 samples, max 1500.00 us", text)
+        self.assertIn("50.00%", text)
+
+    def test_cycles_to_us(self):
+        stats = read_stats.decode(stats_report(0, 0, 125000000, 1, 250, [1]))
+        self.assertAlmostEqual(read_stats.to_us(250, stats), 2.0)
+
+    def test_latency(self):
+        values = list(range(1, len(read_stats.LATENCY_FIELDS) - 1)) + [-40, -7]
+        fmt = "<" + "".join(f for _, f in read_stats.LATENCY_FIELDS)
+        report = pad(bytes([0]) + struct.pack(fmt, *values),
+                     LATENCY_REPORT_SIZE)
+        for r in (report, bytes([read_stats.REPORT_ID_LATENCY]) + report):
+            stats = read_stats.decode_latency(r)
+            self.assertEqual(list(stats.values()), values)
+            self.assertEqual(stats["latency_last_us"], 1)
+            self.assertEqual(stats["sof_offset_us"], -40)
+            self.assertEqual(stats["sof_offset_max_us"], -7)
+        self.assertIn("loops_per_ms: 4", read_stats.format_latency(stats))
+
+    def test_latency_fields_fit(self):
+        fmt = "<" + "".join(f for _, f in read_stats.LATENCY_FIELDS)
+        self.assertEqual(1 + struct.calcsize(fmt), LATENCY_REPORT_SIZE)
+
+    def test_sched(self):
+        counts = []
+        for i in range(len(read_stats.SCHEDULERS)):
+            counts += [1000 + i, 0xfffffff0 + i]
+        report = pad(bytes([1]) + struct.pack("<%dI" % len(counts), *counts),
+                     LATENCY_REPORT_SIZE)
+        stats = read_stats.decode_latency(report)
+        self.assertEqual(list(stats), read_stats.SCHEDULERS)
+        for i, name in enumerate(read_stats.SCHEDULERS):
+            self.assertEqual(stats[name], {"sent": 1000 + i,
+                                           "suppressed": 0xfffffff0 + i})
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,114 @@
+/**
+ * Seqlocks across two threads, standing in for the two cores
+ * @author SpeedyPotato
+ *
+ * A writer thread keeps publishing lights_shared and pixels_shared with every
+ * byte derived from a counter, the way core 0 does under lights_lock and
+ * pixels_lock. The main thread reads them back the way core 1 does, with
+ * seqlock_read and pixels_fetch, and every copy they accept has to come from
+ * a single write, never going back to an older one.
+ **/
+#include <pthread.h>
+#include <sched.h>
+
+#include "test.h"
+
+#define SEQLOCK_TEST_READS 2000000
+
+volatile bool seqlock_test_stop;
+
+/**
+ * @return Byte n of a write's pattern
+ **/
+static inline uint8_t seqlock_test_byte(uint32_t n, int i) {
+  return (uint8_t)(n * 7 + i);
+}
+
+void* seqlock_test_writer(void* arg) {
+  (void)arg;
+  for (uint32_t n = 1; !seqlock_test_stop; n++) {
+    seqlock_write_begin(&lights_lock);
+    for (int i = 0; i < WS2812B_LED_ZONES; i++) {
+      lights_shared.rgb[i] = (RGB_t){seqlock_test_byte(n, 3 * i),
+                                     seqlock_test_byte(n, 3 * i + 1),
+                                     seqlock_test_byte(n, 3 * i + 2)};
+    }
+    lights_shared.reactive_timeout_timestamp = n;
+    if (n % 16 == 0) sched_yield();  // Let the reader in mid write now and then
+    for (int i = 0; i < ENC_GPIO_SIZE; i++) lights_shared.enc_val[i] = n + i;
+    seqlock_write_end(&lights_lock);
+
+    seqlock_write_begin(&pixels_lock);
+    for (int i = 0; i < WS2812B_LED_SIZE; i++) {
+      pixels_shared.rgb[i] = (RGB_t){seqlock_test_byte(n, 3 * i),
+                                     seqlock_test_byte(n, 3 * i + 1),
+                                     seqlock_test_byte(n, 3 * i + 2)};
+    }
+    if (n % 16 == 8) sched_yield();
+    pixels_shared.timestamp = n;
+    seqlock_write_end(&pixels_lock);
+  }
+  return NULL;
+}
+
+/**
+ * Every byte of a lights copy is from write n, and n never goes back
+ **/
+void seqlock_test_lights(const lights_state_t* s, uint64_t* last) {
+  uint32_t n = s->reactive_timeout_timestamp;
+  CHECK(n >= *last);
+  *last = n;
+  if (n == 0) return;  // Before the first write
+  for (int i = 0; i < WS2812B_LED_ZONES; i++) {
+    CHECK_EQ(s->rgb[i].r, seqlock_test_byte(n, 3 * i));
+    CHECK_EQ(s->rgb[i].g, seqlock_test_byte(n, 3 * i + 1));
+    CHECK_EQ(s->rgb[i].b, seqlock_test_byte(n, 3 * i + 2));
+  }
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) CHECK_EQ(s->enc_val[i], n + i);
+}
+
+/**
+ * Same for the frame pixels_fetch points at
+ **/
+void seqlock_test_pixels(const pixels_frame_t* f, uint64_t* last) {
+  uint32_t n = f->timestamp;
+  CHECK(n >= *last);
+  *last = n;
+  if (n == 0) return;  // Nothing fetched yet
+  for (int i = 0; i < WS2812B_LED_SIZE; i++) {
+    CHECK_EQ(f->rgb[i].r, seqlock_test_byte(n, 3 * i));
+    CHECK_EQ(f->rgb[i].g, seqlock_test_byte(n, 3 * i + 1));
+    CHECK_EQ(f->rgb[i].b, seqlock_test_byte(n, 3 * i + 2));
+  }
+}
+
+int main() {
+  pthread_t writer;
+  CHECK_EQ(pthread_create(&writer, NULL, seqlock_test_writer, NULL), 0);
+
+  uint64_t lights_last = 0;
+  uint64_t pixels_last = 0;
+  uint32_t lights_ok = 0;
+  uint32_t pixels_new = 0;
+  for (int r = 0; r < SEQLOCK_TEST_READS; r++) {
+    lights_state_t state;
+    if (seqlock_read(&lights_lock, &state, &lights_shared, sizeof(state))) {
+      seqlock_test_lights(&state, &lights_last);
+      lights_ok++;
+    }
+    const pixels_frame_t* frame = pixels_frame;
+    pixels_fetch();
+    pixels_new += pixels_frame != frame;
+    seqlock_test_pixels(pixels_frame, &pixels_last);
+  }
+  seqlock_test_stop = true;
+  pthread_join(writer, NULL);
+
+  printf("seqlock: %" PRIu32 " of %d lights reads kept, %" PRIu32
+         " pixel frames fetched, %" PRIu64 " writes\n",
+         lights_ok, SEQLOCK_TEST_READS, pixels_new, lights_last);
+  CHECK(lights_ok > 0);
+  CHECK(pixels_new > 0);
+  printf("seqlock: ok\n");
+  return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * SOF phase tracking against hosts with off clocks and callback jitter
+ * @author SpeedyPotato
+ *
+ * The host's frames are SOF_TEST_PPM off 1 ms on the device clock, up to the
+ * 500 ppm USB full speed allows either way. The loop runs every 5 to 30 us,
+ * tud_task sees each SOF up to SOF_TEST_JITTER_US late, and sof_due gates the
+ * rest of the pass. Once settled, the estimated SOF has to stay within
+ * SOF_TEST_ERROR_US of the real one and reports have to be built once per
+ * frame, USB_SOF_LEAD_US before the next SOF give or take a pass.
+ **/
+#include "test.h"
+
+#define SOF_TEST_SECONDS 60
+#define SOF_TEST_SETTLE_FRAMES 3000
+#define SOF_TEST_JITTER_US 40
+#define SOF_TEST_PASS_MAX_US 30
+#define SOF_TEST_ERROR_US 10
+
+static const int sof_test_ppm[] = {-500, -300, -100, 0, 100, 200, 300, 500};
+
+/**
+ * One host, from power on
+ * @param ppm How much longer the host's frames are than 1 ms, in ppm
+ **/
+void test_host(int ppm) {
+  sof_locked = false;
+  sof_frame = sof_sent_frame = 0;
+  sof_sample_timestamp = 0;
+
+  const double period = SOF_PERIOD_US * (1 + ppm / 1e6);
+  const double start = 1000000 + test_range(0, 999);
+  uint32_t frame = test_range(0, SOF_FRAME_MASK);
+  uint64_t now = start;
+  uint32_t n = 0;  // Frames since start
+  double sof = start;
+  double callback = sof + test_range(0, SOF_TEST_JITTER_US);
+  double worst = 0;
+  uint32_t built = 0;
+  int64_t built_frame = -1;
+
+  while (n < SOF_TEST_SECONDS * 1000) {
+    now += test_range(5, SOF_TEST_PASS_MAX_US);
+    if (now >= callback) {
+      sof_update(frame, now);
+      if (n >= SOF_TEST_SETTLE_FRAMES) {
+        double error = (double)sof_timestamp - sof;
+        if (error < 0) error = -error;
+        if (error > worst) worst = error;
+        CHECK(error <= SOF_TEST_ERROR_US);
+        if (n > SOF_TEST_SETTLE_FRAMES) CHECK_EQ(built_frame, n - 1);
+      }
+      n++;
+      frame = (frame + 1) & SOF_FRAME_MASK;
+      sof = start + n * period;
+      callback = sof + test_range(0, SOF_TEST_JITTER_US);
+    }
+    if (sof_due(now) && n > SOF_TEST_SETTLE_FRAMES) {
+      // Built for the SOF after the one seen last, which is at sof
+      double lead = sof - now;
+      CHECK(lead >= USB_SOF_LEAD_US - SOF_TEST_PASS_MAX_US - SOF_TEST_ERROR_US);
+      CHECK(lead <= USB_SOF_LEAD_US + SOF_TEST_ERROR_US);
+      CHECK(built_frame != n - 1);
+      built_frame = n - 1;
+      built++;
+    }
+  }
+  printf("sof: host %+4d ppm, worst phase error %.1f us, %" PRIu32
+         " reports\n",
+         ppm, worst, built);
+}
+
+int main() {
+  config_default(&config);
+  for (int i = 0; i < count_of(sof_test_ppm); i++) test_host(sof_test_ppm[i]);
+  printf("sof: ok\n");
+  return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * Fixed point turbocharger against the original float version
+ * @author SpeedyPotato
+ *
+ * ref_* is turbocharger_color_cycle as it was before it moved to fixed
+ * point, with the knob delta passed in. Both are fed the same knob turns and
+ * idle spells frame by frame and every channel of every LED has to agree to
+ * within TURBO_TEST_TOLERANCE.
+ *
+ * Whether a knob counts as moving is a threshold on a counter which both
+ * versions round differently, so right at the threshold they can decide a
+ * frame apart and then drift a whole step apart. When that happens the
+ * reference takes over the fixed point state, which is only allowed with the
+ * counter within TURBO_TEST_EDGE of the threshold.
+ **/
+#include "test.h"
+
+#define TURBO_TEST_FRAMES 50000
+#define TURBO_TEST_TOLERANCE 2
+#define TURBO_TEST_EDGE 0.002f
+
+float ref_cur_enc_val[ENC_GPIO_SIZE];
+float ref_lights_pos[ENC_GPIO_SIZE];
+float ref_lights_brightness[ENC_GPIO_SIZE];
+int ref_lights_idle[ENC_GPIO_SIZE];
+uint8_t ref_frame[WS2812B_LED_SIZE][3];
+
+float f_clamp(float d, float min, float max) {
+  const float t = d < min ? min : d;
+  return t > max ? max : t;
+}
+
+float f_one_mod(float d, float mod) {
+  const float t = d < 0 ? d + mod : d;
+  return t > mod ? t - mod : t;
+}
+
+float f_abs(float d) { return d < 0 ? -d : d; }
+
+void ref_step(const int* enc_delta) {
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    ref_cur_enc_val[i] =
+        f_clamp(ref_cur_enc_val[i] + (float)(enc_delta[i]) / ENC_PULSE, -0.1f,
+                0.1f);
+
+    if (ref_cur_enc_val[i] < -0.05f) {
+      ref_lights_idle[i] = 0;
+      ref_lights_pos[i] += 0.12f;
+      ref_lights_brightness[i] = 1.0f;
+    } else if (ref_cur_enc_val[i] > 0.05f) {
+      ref_lights_idle[i] = 0;
+      ref_lights_pos[i] -= 0.12f;
+      ref_lights_brightness[i] = 1.0f;
+    } else {
+      ref_lights_idle[i]++;
+      if (ref_lights_idle[i] > 40) {
+        ref_lights_pos[i] = 0;
+      } else {
+        ref_lights_brightness[i] =
+            f_clamp(ref_lights_brightness[i] - 0.025f, 0.0f, 1.0f);
+      }
+    }
+
+    ref_lights_pos[i] =
+        f_one_mod(ref_lights_pos[i], WS2812B_LED_SIZE + 6.0f);
+
+    if (ref_cur_enc_val[i] < -0.0005f) {
+      ref_cur_enc_val[i] += 0.0005f;
+    } else if (ref_cur_enc_val[i] > 0.0005f) {
+      ref_cur_enc_val[i] -= 0.0005f;
+    }
+  }
+}
+
+void ref_render() {
+  for (int i = 0; i < WS2812B_LED_SIZE; i++) {
+    float pos = 2.0f + i + (i >= WS2812B_LED_SIZE / 2 ? 3.0f : 0.0f);
+    float l_strength =
+        (1.0f - f_clamp(f_abs(ref_lights_pos[0] - pos), 0.0f, 2.0f) / 2) *
+        ref_lights_brightness[0];
+    float r_strength =
+        (1.0f - f_clamp(f_abs(ref_lights_pos[1] - pos), 0.0f, 2.0f) / 2) *
+        ref_lights_brightness[1];
+    ref_frame[i][0] = i_clamp(l_strength * 70 + r_strength * 250, 0, 255);
+    ref_frame[i][1] = i_clamp(l_strength * 230 + r_strength * 60, 0, 255);
+    ref_frame[i][2] = i_clamp(l_strength * 250 + r_strength * 200, 0, 255);
+  }
+}
+
+/**
+ * Next knob movement: spins either way at varying speeds, then rests long
+ * enough for the lights to fade out
+ **/
+int turbo_test_delta(int i, uint32_t frame) {
+  static int speed[ENC_GPIO_SIZE];
+  static uint32_t until[ENC_GPIO_SIZE];
+  if (frame >= until[i]) {
+    bool rest = speed[i] != 0;
+    speed[i] = rest ? 0 : (int)test_range(1, 40) * (test_rand() & 1 ? 1 : -1);
+    until[i] = frame + (rest ? test_range(10, 120) : test_range(20, 400));
+  }
+  return speed[i];
+}
+
+int main() {
+  config_default(&config);
+  uint32_t worst = 0;
+  uint32_t resyncs = 0;
+  for (uint32_t frame = 1; frame <= TURBO_TEST_FRAMES; frame++) {
+    int delta[ENC_GPIO_SIZE];
+    for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+      delta[i] = turbo_test_delta(i, frame);
+      // turbocharger_color_cycle negates unreversed knobs
+      lights_state.enc_val[i] -= delta[i] * (enc_rev(i) ? -1 : 1);
+    }
+
+    ws2812b_fb_pos = 0;
+    turbocharger_color_cycle(frame);
+    ref_step(delta);
+
+    for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+      if (ref_lights_idle[i] == turbo_lights_idle[i]) continue;
+      float edge = f_abs(f_abs(ref_cur_enc_val[i]) - 0.05f);
+      if (edge > TURBO_TEST_EDGE) {
+        fprintf(stderr, "frame %" PRIu32 " knob %d: moving %d vs %d\n",
+                frame, i, turbo_lights_idle[i] == 0, ref_lights_idle[i] == 0);
+        return 1;
+      }
+      ref_cur_enc_val[i] = turbo_cur_enc_val[i] / 16777216.0f;
+      ref_lights_pos[i] = turbo_lights_pos[i] / 65536.0f;
+      ref_lights_brightness[i] = turbo_lights_brightness[i] / 65536.0f;
+      ref_lights_idle[i] = turbo_lights_idle[i];
+      resyncs++;
+    }
+    ref_render();
+
+    for (int i = 0; i < WS2812B_LED_SIZE; i++) {
+      uint32_t grb = ws2812b_fb[ws2812b_fb_back][i] >> 8;
+      int got[3] = {(grb >> 8) & 0xff, (grb >> 16) & 0xff, grb & 0xff};
+      for (int c = 0; c < 3; c++) {
+        uint32_t diff = abs(got[c] - ref_frame[i][c]);
+        if (diff > worst) worst = diff;
+        if (diff > TURBO_TEST_TOLERANCE) {
+          fprintf(stderr, "frame %" PRIu32 " led %d channel %d: %d vs %d\n",
+                  frame, i, c, got[c], ref_frame[i][c]);
+          return 1;
+        }
+      }
+    }
+  }
+  printf("turbocharger: %d frames, worst channel error %" PRIu32
+         ", %" PRIu32 " threshold resyncs\n",
+         TURBO_TEST_FRAMES, worst, resyncs);
+  CHECK(resyncs < TURBO_TEST_FRAMES / 100);
+  return 0;
+}
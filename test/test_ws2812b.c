@@ -0,0 +1,88 @@
+/**
+ * WS2812B framebuffer: bit plane transpose for ws2812_parallel, pin checks and
+ * the latch gap between frames
+ * @author SpeedyPotato
+ **/
+#include "test.h"
+
+#define WS_TEST_LEN 20
+
+/**
+ * Every bit of every pixel lands in its plane word, MSB first, strip s in
+ * bit s, for every strip count ws2812_parallel takes
+ **/
+void test_transpose() {
+  uint32_t fb[32 * WS_TEST_LEN];
+  uint32_t planes[WS_TEST_LEN * 24];
+  for (int strips = 1; strips <= 32; strips++) {
+    for (int i = 0; i < strips * WS_TEST_LEN; i++) {
+      fb[i] = test_rand() << 8;  // GRB in the top 24 bits, like put_pixel
+    }
+    fb[0] = 0;
+    fb[strips * WS_TEST_LEN - 1] = 0xffffff00u;
+    memset(planes, 0xa5, sizeof(planes));  // Stale planes must be cleared
+    ws2812b_transpose(fb, planes, strips, WS_TEST_LEN);
+
+    for (int p = 0; p < WS_TEST_LEN; p++) {
+      for (int b = 0; b < 24; b++) {
+        uint32_t expect = 0;
+        for (int s = 0; s < strips; s++) {
+          expect |= ((fb[s * WS_TEST_LEN + p] >> (31 - b)) & 1) << s;
+        }
+        CHECK_EQ(planes[p * 24 + b], expect);
+      }
+    }
+  }
+}
+
+/**
+ * Switch, switch LED and both encoder pins are taken, the strip pin isn't
+ **/
+void test_pins() {
+  for (int i = 0; i < SW_GPIO_SIZE; i++) CHECK(ws2812b_pin_taken(SW_GPIO[i]));
+  for (int i = 0; i < LED_GPIO_SIZE; i++) CHECK(ws2812b_pin_taken(LED_GPIO[i]));
+  for (int i = 0; i < ENC_GPIO_SIZE; i++) {
+    CHECK(ws2812b_pin_taken(ENC_GPIO[i]));
+    CHECK(ws2812b_pin_taken(ENC_GPIO[i] + 1));
+  }
+  for (int i = 0; i < WS2812B_STRIPS; i++) {
+    CHECK(!ws2812b_pin_taken(WS2812B_GPIO + i));
+  }
+}
+
+/**
+ * Back to back frames: each DMA starts only once the last frame has been
+ * clocked out and the line has been low for WS2812B_RESET_US, however soon
+ * ws2812b_show is called again
+ **/
+void test_latch() {
+  fake_reset();
+  init();
+  for (int n = 0; n < 100; n++) {
+    int pixels = WS2812B_STRIPS > 1 ? WS2812B_LEDS_PER_STRIP
+                                    : test_range(1, WS2812B_LED_SIZE);
+    for (int i = 0; i < (WS2812B_STRIPS > 1 ? WS2812B_LED_SIZE : pixels); i++) {
+      put_pixel(urgb_u32(test_rand(), test_rand(), test_rand()));
+    }
+    uint64_t last = fake_dma[ws2812b_dma].start_time;
+    fake_time_us += test_range(0, 2000);
+    ws2812b_show();
+    uint64_t start = fake_dma[ws2812b_dma].start_time;
+    CHECK(fake_dma[ws2812b_dma].started);
+    CHECK_EQ(start, fake_time_us);
+    CHECK(ws2812b_latch_time >=
+          start + (pixels * 24 * WS2812B_BIT_NS) / 1000 + WS2812B_RESET_US);
+    if (n > 0) CHECK(start >= last + WS2812B_RESET_US);
+    uint64_t latch = ws2812b_latch_time;
+    ws2812b_show();  // Nothing drawn, still waits for the frame above
+    CHECK(fake_dma[ws2812b_dma].start_time >= latch);
+  }
+}
+
+int main() {
+  test_transpose();
+  test_pins();
+  test_latch();
+  printf("ws2812b: ok\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+Reads the timing histograms from a Pico Game Controller over the
+REPORT_ID_STATS feature report, see src/stats/histogram.c for the layout,
+and the hot path counters over REPORT_ID_LATENCY, see src/stats/latency.c.
+
+Usage: read_stats.py [metric ...] [--reset]
+Metrics are the histograms below, plus "latency" for the latency counters and
+"sched" for reports sent and suppressed by each report scheduler.
+--reset clears the metrics instead of printing them.
+Needs the hidapi module (pip install hidapi).
+"""
+import struct
+import sys
+
+VID = 0xCAFE
+PIDS = (0x4004, 0x4024)  # Gamepad mode, keyboard mode
+REPORT_ID_STATS = 5
+REPORT_ID_LATENCY = 9
+METRICS = ["loop", "debounce", "tud_task", "render", "report"]
+UNITS = ["cycles", "us"]
+PAGES = ["latency", "sched"]
+# latency_stats_t in field order, "i" fields are signed
+LATENCY_FIELDS = [
+    ("latency_last_us", "I"), ("latency_max_us", "I"),
+    ("latency_count", "I"), ("loops_per_ms", "I"),
+    ("loops_per_ms_min", "I"), ("reports_per_s_0", "I"),
+    ("reports_per_s_1", "I"), ("sched_late_max_us", "I"),
+    ("enc_irqs_per_s", "I"), ("lights_dropped_per_s", "I"),
+    ("sof_offset_us", "i"), ("sof_offset_max_us", "i"),
+]
+SCHEDULERS = ["gamepad", "keyboard", "mouse"]
+
+
+def decode(report):
+    """Decodes a stats feature report, with or without the report ID."""
+    if len(report) == 64:
+        report = report[1:]
+    metric, unit, buckets, hz, count, peak = struct.unpack_from("<BBBIII", report)
+    counts = struct.unpack_from("<%dH" % buckets, report, 15)
+    return {
+        "metric": METRICS[metric] if metric < len(METRICS) else metric,
+        "unit": UNITS[unit],
+        "hz": hz,
+        "count": count,
+        "max": peak,
+        "buckets": counts,
+    }
+
+
+def decode_latency(report):
+    """Decodes a latency feature report, with or without the report ID."""
+    if len(report) == 50:
+        report = report[1:]
+    page = report[0]
+    if page == PAGES.index("latency"):
+        fmt = "<" + "".join(f for _, f in LATENCY_FIELDS)
+        values = struct.unpack_from(fmt, report, 1)
+        return dict(zip([n for n, _ in LATENCY_FIELDS], values))
+    stats = {}
+    for i, name in enumerate(SCHEDULERS):
+        sent, suppressed = struct.unpack_from("<II", report, 1 + i * 8)
+        stats[name] = {"sent": sent, "suppressed": suppressed}
+    return stats
+
+
+def format_latency(stats):
+    return "\n".join("%s: %s" % item for item in stats.items())
+
+
+def to_us(value, stats):
+    """Converts a value in the metric's unit to us."""
+    return value * 1e6 / stats["hz"] if stats["unit"] == "cycles" else value
+
+
+def format_stats(stats):
+    lines = ["%s: %d samples, max %.2f us" % (stats["metric"], stats["count"],
+                                              to_us(stats["max"], stats))]
+    total = sum(stats["buckets"]) or 1
+    for b, n in enumerate(stats["buckets"]):
+        if n:
+            lines.append("  >= %10.2f us %6.2f%% %s" %
+                         (to_us(1 << b, stats), 100.0 * n / total,
+                          "#" * (50 * n // total)))
+    return "\n".join(lines)
+
+
+def main(argv):
+    import hid
+
+    reset = "--reset" in argv
+    names = [a for a in argv if not a.startswith("--")] or METRICS + PAGES
+    for pid in PIDS:
+        try:
+            dev = hid.device()
+            dev.open(VID, pid)
+            break
+        except OSError:
+            continue
+    else:
+        sys.exit("controller not found")
+
+    for name in names:
+        if name in PAGES:
+            page = PAGES.index(name)
+            select = [REPORT_ID_LATENCY, page | (0x80 if reset else 0)]
+            dev.send_feature_report(select + [0] * 48)
+            if not reset:
+                print(format_latency(decode_latency(bytes(
+                    dev.get_feature_report(REPORT_ID_LATENCY, 50)))))
+            continue
+        metric = METRICS.index(name)
+        select = [REPORT_ID_STATS, metric | (0x80 if reset else 0)]
+        dev.send_feature_report(select + [0] * 62)
+        if reset:
+            continue
+        print(format_stats(decode(bytes(dev.get_feature_report(REPORT_ID_STATS,
+                                                               64)))))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])